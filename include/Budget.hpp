@@ -0,0 +1,90 @@
+/** ****************************************************************************
+ *  @file    Budget.hpp
+ *  @brief   Distribute the generated samples from the classifier errors.
+ *  @author  Roberto Valle Fernandez.
+ *  @date    2012/01
+ *  @copyright All rights reserved.
+ *  Escuela Tecnica Superior de Ingenieria Informatica (Computer Science School)
+ *  Universidad Rey Juan Carlos (Spain)
+ ******************************************************************************/
+
+// ------------------ RECURSION PROTECTION -------------------------------------
+#ifndef BUDGET_HPP
+#define BUDGET_HPP
+
+// ----------------------- INCLUDES --------------------------------------------
+#include <map>
+#include <string>
+#include <vector>
+
+namespace urjc {
+
+/** ****************************************************************************
+ * @class Budget
+ * @brief Error rate of each character, and optionally of each character and
+ * font, read from a confusion matrix or from per-class errors. A confusion
+ * counts against both the true and the predicted character, so confusable
+ * pairs get more samples on both sides.
+ ******************************************************************************/
+class Budget
+{
+public:
+
+  // Constructor
+  Budget
+    () {};
+
+  // Destroyer
+  ~Budget
+    () {};
+
+  /**
+   * @brief Read a text file of 'confusion <true> <predicted> <count>',
+   * 'error <character> <rate>' and 'error <character> <font> <rate>' lines.
+   */
+  bool
+  load
+    (
+    const std::string &filename
+    );
+
+  /**
+   * @brief Returns true if no errors were loaded.
+   */
+  bool
+  empty
+    () const { return m_errors.empty() && m_font_errors.empty(); };
+
+  /**
+   * @brief Relative number of samples of a character rendered with a font.
+   */
+  double
+  weight
+    (
+    const std::string &character,
+    const std::string &font
+    ) const;
+
+  /**
+   * @brief Split a total number of samples proportionally to the weights.
+   */
+  static void
+  allocate
+    (
+    const std::vector<double> &weights,
+    const unsigned total,
+    std::vector<unsigned> &counts
+    );
+
+private:
+
+  // Error rate of each character
+  std::map<std::string, double> m_errors;
+
+  // Error rate of each '<character> <font>'
+  std::map<std::string, double> m_font_errors;
+};
+
+} // close namespace urjc
+
+#endif /* BUDGET_HPP */
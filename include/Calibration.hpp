@@ -0,0 +1,107 @@
+/** ****************************************************************************
+ *  @file    Calibration.hpp
+ *  @brief   Choose the threads, batch size and compression level of a run.
+ *  @author  Roberto Valle Fernandez.
+ *  @date    2012/01
+ *  @copyright All rights reserved.
+ *  Escuela Tecnica Superior de Ingenieria Informatica (Computer Science School)
+ *  Universidad Rey Juan Carlos (Spain)
+ ******************************************************************************/
+
+// ------------------ RECURSION PROTECTION -------------------------------------
+#ifndef CALIBRATION_HPP
+#define CALIBRATION_HPP
+
+// ----------------------- INCLUDES --------------------------------------------
+#include <string>
+#include <vector>
+#include <MyFreetype.hpp>
+
+namespace urjc {
+
+/** ****************************************************************************
+ * @class Calibration
+ * @brief Runs the real pipeline on the first fonts of a run with several
+ * configurations, keeps the fastest one whose projected peak memory fits the
+ * limit and projects the runtime, disk and memory of the whole run.
+ ******************************************************************************/
+class Calibration
+{
+public:
+
+  // Constructor
+  Calibration
+    (
+    const std::string &fonts_dir,
+    const std::vector<std::string> &fonts
+    );
+
+  // Destroyer
+  ~Calibration
+    () {};
+
+  /**
+   * @brief Measure each stage on a copy of a configured generator.
+   */
+  void
+  run
+    (
+    const MyFreetype &freetype,
+    const size_t memory_limit
+    );
+
+  /**
+   * @brief Set the chosen configuration.
+   */
+  void
+  apply
+    (
+    MyFreetype &freetype
+    ) const;
+
+  /**
+   * @brief Print the measured rates, the chosen configuration and the
+   * projection of the whole run.
+   */
+  void
+  print
+    () const;
+
+private:
+
+  /**
+   * @brief Images per second saving a transformed generator.
+   */
+  double
+  measureSave
+    (
+    MyFreetype &trial
+    ) const;
+
+  /**
+   * @brief Projected peak memory of the whole run with a batch size.
+   */
+  double
+  projectedMemory
+    (
+    const unsigned batch_size
+    ) const;
+
+  std::string m_fonts_dir;
+  std::vector<std::string> m_fonts;
+  unsigned m_sample_fonts;
+
+  // Measured on the sample fonts
+  unsigned m_bitmaps, m_samples;
+  double m_render_rate, m_transform_rate, m_save_rate;
+  double m_memory, m_bytes_per_sample;
+  size_t m_memory_limit;
+
+  // Chosen configuration
+  unsigned m_transform_threads, m_encode_threads, m_batch_size;
+  int m_compression;
+};
+
+} // close namespace urjc
+
+#endif /* CALIBRATION_HPP */
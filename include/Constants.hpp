@@ -22,9 +22,23 @@ class Constants
 {
 public:
 
-  static const char *FONTS_DIR, *CHARS_DIR;
+  static const char *FONTS_DIR, *CHARS_DIR, *CATALOG_FILE, *CALIBRATION_DIR;
   static const double ROTATION_ANGLE;
-  static const unsigned CHAR_SIZE, NUM_ITERS;
+  static const unsigned CHAR_SIZE, CHAR_DPI, NUM_ITERS;
+  static const unsigned DEDUP_RETRIES;
+  static const unsigned LINE_LENGTH, LINE_MARGIN;
+  static const double LINE_CONTEXT;
+  static const double GOLDEN_MARGIN;
+  static const double BUDGET_FLOOR;
+  static const unsigned SDF_SCALE, SUPERSAMPLE_MAX;
+  static const unsigned INK_THRESHOLD;
+  static const unsigned BATCH_SIZE, CALIBRATION_FONTS, MEMORY_LIMIT;
+  static const unsigned SHARD_SIZE, SHUFFLE_MEMORY;
+  static const unsigned BUDGET_CHUNK;
+  static const char *CHECKPOINT_FILE;
+  static const int PNG_COMPRESSION;
+  static const unsigned NOISE_TILES, NOISE_TILE_SIZE, NOISE_SEED;
+  static const unsigned JPEG_QUALITY_MIN, JPEG_QUALITY_MAX;
 };
 
 } // close namespace urjc
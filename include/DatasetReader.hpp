@@ -0,0 +1,176 @@
+/** ****************************************************************************
+ *  @file    DatasetReader.hpp
+ *  @brief   Prefetching and shuffling reader of generated datasets.
+ *  @author  Roberto Valle Fernandez.
+ *  @date    2012/01
+ *  @copyright All rights reserved.
+ *  Escuela Tecnica Superior de Ingenieria Informatica (Computer Science School)
+ *  Universidad Rey Juan Carlos (Spain)
+ ******************************************************************************/
+
+// ------------------ RECURSION PROTECTION -------------------------------------
+#ifndef DATASETREADER_HPP
+#define DATASETREADER_HPP
+
+// ----------------------- INCLUDES --------------------------------------------
+#include <map>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <stdint.h>
+#include <opencv/cv.h>
+
+namespace urjc {
+
+/**
+ * @brief Decoded images of a batch and the index of their class. Buffers are
+ * reused between batches.
+ */
+struct Batch
+{
+  Batch() : size(0) {};
+  unsigned size;
+  std::vector<cv::Mat> images;
+  std::vector<unsigned> labels;
+};
+
+/**
+ * @brief Location of an encoded image, a file or a range of a tar shard.
+ */
+struct DatasetEntry
+{
+  unsigned label;
+  // Source file, or shard index in shard mode
+  std::string path;
+  int shard;
+  uint64_t offset, size;
+};
+
+/** ****************************************************************************
+ * @class DatasetReader
+ * @brief Reads the images saved by the generator, either the directory tree
+ * of PNG files or the tar shards and their indexes. A pool of threads reads
+ * and decodes whole batches ahead of the consumer.
+ *
+ * Each epoch shuffles the groups of consecutive entries (a class directory or
+ * a shard), then passes the entries through a shuffle buffer of bounded size,
+ * so reads stay local within the buffer.
+ ******************************************************************************/
+class DatasetReader
+{
+public:
+
+  // Constructor
+  DatasetReader
+    (
+    const std::string &dataset_dir,
+    const unsigned num_threads,
+    const unsigned batch_size,
+    const unsigned shuffle_size,
+    const uint64_t seed
+    );
+
+  // Destroyer
+  ~DatasetReader
+    ();
+
+  size_t
+  size
+    () const { return m_entries.size(); };
+
+  /**
+   * @brief Name of each class, the relative directory of its images.
+   */
+  const std::vector<std::string>&
+  labels
+    () const { return m_labels; };
+
+  const std::vector<DatasetEntry>&
+  entries
+    () const { return m_entries; };
+
+  /**
+   * @brief Shuffle the entries and start prefetching the first batches.
+   */
+  void
+  startEpoch
+    ();
+
+  /**
+   * @brief Returns the next batch of the epoch in order, or NULL at its end.
+   * Batches must be released to be reused.
+   */
+  const Batch*
+  next
+    ();
+
+  void
+  release
+    (
+    const Batch *batch
+    );
+
+  /**
+   * @brief Read the encoded bytes of an entry.
+   */
+  bool
+  readEntry
+    (
+    const DatasetEntry &entry,
+    std::vector<uchar> &buffer
+    ) const;
+
+private:
+
+  void
+  listFiles
+    (
+    const std::string &dataset_dir
+    );
+
+  void
+  listShards
+    (
+    const std::string &dataset_dir
+    );
+
+  /**
+   * @brief Worker loop that fills free batches.
+   */
+  void
+  prefetch
+    ();
+
+  void
+  stopWorkers
+    ();
+
+  unsigned m_num_threads, m_batch_size, m_shuffle_size;
+  uint64_t m_seed;
+  unsigned m_epoch;
+
+  std::vector<std::string> m_labels;
+  std::vector<DatasetEntry> m_entries;
+  // First entry of each group of consecutive entries
+  std::vector<unsigned> m_groups;
+  // File descriptor of each shard
+  std::vector<int> m_shards;
+
+  // Entry order of the current epoch
+  std::vector<unsigned> m_order;
+  unsigned m_num_batches, m_next_batch, m_emitted;
+
+  std::vector<Batch> m_batches;
+  std::vector<Batch*> m_free;
+  std::map<unsigned, Batch*> m_ready;
+  std::vector<std::thread> m_workers;
+  std::mutex m_mutex;
+  std::condition_variable m_condition;
+  bool m_stop;
+};
+
+} // close namespace urjc
+
+#endif /* DATASETREADER_HPP */
@@ -0,0 +1,89 @@
+/** ****************************************************************************
+ *  @file    Degradation.hpp
+ *  @brief   Scanner and camera degradations from precomputed banks.
+ *  @author  Roberto Valle Fernandez.
+ *  @date    2012/01
+ *  @copyright All rights reserved.
+ *  Escuela Tecnica Superior de Ingenieria Informatica (Computer Science School)
+ *  Universidad Rey Juan Carlos (Spain)
+ ******************************************************************************/
+
+// ------------------ RECURSION PROTECTION -------------------------------------
+#ifndef DEGRADATION_HPP
+#define DEGRADATION_HPP
+
+// ----------------------- INCLUDES --------------------------------------------
+#include <vector>
+#include <operations.hpp>
+#include <opencv/cv.h>
+
+namespace urjc {
+
+/** ****************************************************************************
+ * @class Degradation
+ * @brief Motion and defocus blur, Gaussian and Poisson noise and JPEG
+ * recompression. Point spread functions, noise tiles and noise deviations are
+ * precomputed in banks, so each sample only costs a small convolution and a
+ * look-up per pixel.
+ ******************************************************************************/
+class Degradation
+{
+public:
+
+  // Constructor
+  Degradation
+    () {};
+
+  // Destroyer
+  ~Degradation
+    () {};
+
+  /**
+   * @brief Precomputes the banks, needed before the first 'apply'.
+   */
+  void
+  build
+    ();
+
+  /**
+   * @brief Applies random degradations and records them.
+   */
+  void
+  apply
+    (
+    cv::RNG &rng,
+    cv::Mat &img,
+    Augmentation &aug
+    );
+
+private:
+
+  /**
+   * @brief Adds noise from a random tile scaled by a deviation per intensity.
+   */
+  void
+  addNoise
+    (
+    cv::RNG &rng,
+    cv::Mat &img,
+    const std::vector<float> &deviation
+    ) const;
+
+  // Normalized motion and defocus kernels
+  std::vector<cv::Mat> m_psfs;
+
+  // Unit Gaussian noise tiles
+  std::vector<cv::Mat> m_tiles;
+
+  // Noise deviation for each intensity, constant for Gaussian noise and
+  // proportional to its square root for Poisson noise
+  std::vector< std::vector<float> > m_deviations;
+
+  // Encoder parameters and buffer reused between samples
+  std::vector<int> m_params;
+  std::vector<uchar> m_buffer;
+};
+
+} // close namespace urjc
+
+#endif /* DEGRADATION_HPP */
@@ -0,0 +1,84 @@
+/** ****************************************************************************
+ *  @file    ExternalShuffle.hpp
+ *  @brief   Shuffle encoded samples larger than memory through spill files.
+ *  @author  Roberto Valle Fernandez.
+ *  @date    2012/01
+ *  @copyright All rights reserved.
+ *  Escuela Tecnica Superior de Ingenieria Informatica (Computer Science School)
+ *  Universidad Rey Juan Carlos (Spain)
+ ******************************************************************************/
+
+// ------------------ RECURSION PROTECTION -------------------------------------
+#ifndef EXTERNALSHUFFLE_HPP
+#define EXTERNALSHUFFLE_HPP
+
+// ----------------------- INCLUDES --------------------------------------------
+#include <string>
+#include <vector>
+#include <fstream>
+#include <stdint.h>
+#include <opencv/cv.h>
+#include <ShardWriter.hpp>
+
+namespace urjc {
+
+/** ****************************************************************************
+ * @class ExternalShuffle
+ * @brief Two pass shuffle. Each sample is appended to a random bucket file,
+ * then every bucket is loaded alone, shuffled in memory and written. A random
+ * bucket followed by a random position inside it is a uniform permutation, and
+ * only one bucket is held in memory.
+ ******************************************************************************/
+class ExternalShuffle
+{
+public:
+
+  // Constructor
+  ExternalShuffle
+    (
+    const std::string &spill_dir,
+    const unsigned num_buckets,
+    const uint64_t seed
+    );
+
+  // Destroyer
+  ~ExternalShuffle
+    ();
+
+  /**
+   * @brief Spill an encoded sample into a random bucket.
+   */
+  void
+  add
+    (
+    const std::string &key,
+    const std::vector<uchar> &data,
+    const std::string &label
+    );
+
+  /**
+   * @brief Write every sample in the shuffled order and remove the buckets.
+   */
+  void
+  write
+    (
+    ShardWriter &shards
+    );
+
+private:
+
+  std::string
+  bucketName
+    (
+    const unsigned bucket
+    ) const;
+
+  std::string m_spill_dir;
+  uint64_t m_seed;
+  cv::RNG m_rng;
+  std::vector<std::ofstream*> m_buckets;
+};
+
+} // close namespace urjc
+
+#endif /* EXTERNALSHUFFLE_HPP */
@@ -0,0 +1,110 @@
+/** ****************************************************************************
+ *  @file    FontCatalog.hpp
+ *  @brief   Index of the fonts directory to select fonts without opening them.
+ *  @author  Roberto Valle Fernandez.
+ *  @date    2012/01
+ *  @copyright All rights reserved.
+ *  Escuela Tecnica Superior de Ingenieria Informatica (Computer Science School)
+ *  Universidad Rey Juan Carlos (Spain)
+ ******************************************************************************/
+
+// ------------------ RECURSION PROTECTION -------------------------------------
+#ifndef FONTCATALOG_HPP
+#define FONTCATALOG_HPP
+
+// ----------------------- INCLUDES --------------------------------------------
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+namespace urjc {
+
+/**
+ * @brief Metadata of a font file.
+ */
+struct FontEntry
+{
+  std::string filename, format, family, style;
+  uint64_t file_size, hash;
+  int64_t modified;
+  // Glyph indices lower than 256 with a non empty outline
+  uint64_t coverage[4];
+  // Mean number of outline points of the covered glyphs
+  unsigned complexity;
+};
+
+/** ****************************************************************************
+ * @class FontCatalog
+ * @brief Binary index with the metadata of every file in the fonts directory.
+ * Files are only opened when they are new or their size or modification time
+ * changed since the last refresh.
+ ******************************************************************************/
+class FontCatalog
+{
+public:
+
+  // Constructor
+  FontCatalog
+    () : m_modified(false) {};
+
+  // Destroyer
+  ~FontCatalog
+    () {};
+
+  /**
+   * @brief Read a catalog file. A missing file gives an empty catalog.
+   */
+  void
+  load
+    (
+    const std::string &filename
+    );
+
+  /**
+   * @brief Write the catalog file if it changed since it was loaded.
+   */
+  void
+  save
+    (
+    const std::string &filename
+    );
+
+  /**
+   * @brief Update the entries of new, modified and removed files.
+   */
+  void
+  refresh
+    (
+    const std::string &fonts_dir
+    );
+
+  /**
+   * @brief Returns the True Type fonts that cover every character of interest,
+   * ordered by family and style and without repeated contents.
+   */
+  void
+  select
+    (
+    const std::vector<unsigned> &characters,
+    std::vector<std::string> &filenames
+    ) const;
+
+private:
+
+  /**
+   * @brief Open a font file to fill its entry.
+   */
+  bool
+  analyzeFont
+    (
+    const std::string &path,
+    FontEntry &entry
+    );
+
+  std::vector<FontEntry> m_entries;
+  bool m_modified;
+};
+
+} // close namespace urjc
+
+#endif /* FONTCATALOG_HPP */
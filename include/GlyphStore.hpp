@@ -0,0 +1,111 @@
+/** ****************************************************************************
+ *  @file    GlyphStore.hpp
+ *  @brief   Compact storage of the base glyph bitmaps.
+ *  @author  Roberto Valle Fernandez.
+ *  @date    2012/01
+ *  @copyright All rights reserved.
+ *  Escuela Tecnica Superior de Ingenieria Informatica (Computer Science School)
+ *  Universidad Rey Juan Carlos (Spain)
+ ******************************************************************************/
+
+// ------------------ RECURSION PROTECTION -------------------------------------
+#ifndef GLYPHSTORE_HPP
+#define GLYPHSTORE_HPP
+
+// ----------------------- INCLUDES --------------------------------------------
+#include <vector>
+#include <stdint.h>
+#include <opencv/cv.h>
+
+namespace urjc {
+
+/**
+ * @brief Position of a glyph in the store and size of its bitmap.
+ */
+struct GlyphTile
+{
+  uint64_t offset;
+  unsigned short rows, cols;
+  cv::Rect crop;
+};
+
+/** ****************************************************************************
+ * @class GlyphStore
+ * @brief Glyph bitmaps cropped to their ink and run-length encoded one after
+ * another in a single buffer. With 4 bits per pixel the coverage is quantized
+ * to 16 levels, which makes longer runs and packs two literals per byte.
+ ******************************************************************************/
+class GlyphStore
+{
+public:
+
+  // Constructor
+  GlyphStore
+    () : m_bits(8) {};
+
+  // Destroyer
+  ~GlyphStore
+    () {};
+
+  /**
+   * @brief Bits per pixel, 8 keeps the bitmaps unchanged and 4 quantizes
+   * them. Only valid while the store is empty.
+   */
+  void
+  setBits
+    (
+    const unsigned bits
+    );
+
+  /**
+   * @brief Append an 8 bits image and return its identifier.
+   */
+  unsigned
+  add
+    (
+    const cv::Mat &image
+    );
+
+  /**
+   * @brief Decompress an image reusing the memory of the output if possible.
+   */
+  void
+  decode
+    (
+    const unsigned id,
+    cv::Mat &image
+    ) const;
+
+  /**
+   * @brief Remove every image and release its memory.
+   */
+  void
+  clear
+    ();
+
+  /**
+   * @brief Number of stored images.
+   */
+  size_t
+  size
+    () const { return m_tiles.size(); };
+
+  /**
+   * @brief Bytes of the buffer and the index.
+   */
+  size_t
+  bytes
+    () const;
+
+private:
+
+  unsigned m_bits;
+
+  // Compressed images and their offsets in the buffer
+  std::vector<uchar> m_data;
+  std::vector<GlyphTile> m_tiles;
+};
+
+} // close namespace urjc
+
+#endif /* GLYPHSTORE_HPP */
@@ -0,0 +1,113 @@
+/** ****************************************************************************
+ *  @file    Golden.hpp
+ *  @brief   Compare generated images and throughput against a reference run.
+ *  @author  Roberto Valle Fernandez.
+ *  @date    2012/01
+ *  @copyright All rights reserved.
+ *  Escuela Tecnica Superior de Ingenieria Informatica (Computer Science School)
+ *  Universidad Rey Juan Carlos (Spain)
+ ******************************************************************************/
+
+// ------------------ RECURSION PROTECTION -------------------------------------
+#ifndef GOLDEN_HPP
+#define GOLDEN_HPP
+
+// ----------------------- INCLUDES --------------------------------------------
+#include <map>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <opencv/cv.h>
+
+namespace urjc {
+
+/** ****************************************************************************
+ * @class Golden
+ * @brief Checksums of the images produced by each stage of a run with a fixed
+ * seed, together with the throughput of each stage in images per second.
+ ******************************************************************************/
+class Golden
+{
+public:
+
+  // Constructor
+  Golden
+    () : m_seed(0) {};
+
+  // Destroyer
+  ~Golden
+    () {};
+
+  void
+  setSeed
+    (
+    const uint64_t seed
+    ) { m_seed = seed; };
+
+  uint64_t
+  getSeed
+    () const { return m_seed; };
+
+  /**
+   * @brief Store a checksum of each list of images produced by a stage.
+   */
+  void
+  addChecksums
+    (
+    const std::string &stage,
+    const std::vector< std::vector<cv::Mat> > &images
+    );
+
+  /**
+   * @brief Store the number of images per second processed by a stage.
+   */
+  void
+  addRate
+    (
+    const std::string &stage,
+    const double rate
+    );
+
+  /**
+   * @brief Read a reference run from a text file.
+   */
+  bool
+  load
+    (
+    const std::string &filename
+    );
+
+  /**
+   * @brief Write this run into a text file.
+   */
+  bool
+  save
+    (
+    const std::string &filename
+    ) const;
+
+  /**
+   * @brief Returns true if every checksum matches the reference and no stage
+   * is slower than the reference rate reduced by this margin.
+   */
+  bool
+  compare
+    (
+    const Golden &reference,
+    const double margin
+    ) const;
+
+private:
+
+  uint64_t m_seed;
+
+  // Checksum of each '<stage> <index>' list of images
+  std::map<std::string, uint64_t> m_checksums;
+
+  // Images per second of each stage
+  std::map<std::string, double> m_rates;
+};
+
+} // close namespace urjc
+
+#endif /* GOLDEN_HPP */
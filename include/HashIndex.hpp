@@ -0,0 +1,103 @@
+/** ****************************************************************************
+ *  @file    HashIndex.hpp
+ *  @brief   Perceptual hashing to find near-duplicated images.
+ *  @author  Roberto Valle Fernandez.
+ *  @date    2012/01
+ *  @copyright All rights reserved.
+ *  Escuela Tecnica Superior de Ingenieria Informatica (Computer Science School)
+ *  Universidad Rey Juan Carlos (Spain)
+ ******************************************************************************/
+
+// ------------------ RECURSION PROTECTION -------------------------------------
+#ifndef HASHINDEX_HPP
+#define HASHINDEX_HPP
+
+// ----------------------- INCLUDES --------------------------------------------
+#include <vector>
+#include <unordered_map>
+#include <stdint.h>
+#include <opencv/cv.h>
+
+namespace urjc {
+
+/**
+ * @brief Returns a 64 bits average hash of an image.
+ */
+uint64_t
+perceptualHash
+  (
+  const cv::Mat &img
+  );
+
+/** ****************************************************************************
+ * @class HashIndex
+ * @brief Set of perceptual hashes that answers whether any stored hash lies
+ * within a maximum Hamming distance of a query. Hashes are split in
+ * 'max_distance+1' chunks, so by the pigeonhole principle every near-duplicate
+ * shares at least one chunk exactly with the query (multi-index hashing).
+ ******************************************************************************/
+class HashIndex
+{
+public:
+
+  // Constructor
+  HashIndex
+    (
+    const unsigned max_distance
+    );
+
+  // Destroyer
+  ~HashIndex
+    () {};
+
+  /**
+   * @brief Returns true if a stored hash is within the maximum distance.
+   */
+  bool
+  contains
+    (
+    const uint64_t hash
+    ) const;
+
+  /**
+   * @brief Store a new hash.
+   */
+  void
+  insert
+    (
+    const uint64_t hash
+    );
+
+  /**
+   * @brief Number of stored hashes.
+   */
+  size_t
+  size
+    () const { return m_hashes.size(); };
+
+private:
+
+  /**
+   * @brief Returns the value of a hash chunk.
+   */
+  uint64_t
+  chunk
+    (
+    const uint64_t hash,
+    const unsigned idx
+    ) const;
+
+  unsigned m_max_distance;
+
+  // Bit offset and width of each chunk
+  std::vector<unsigned> m_offsets, m_widths;
+
+  // For each chunk map its value to the hashes that contain it
+  std::vector< std::unordered_map< uint64_t, std::vector<uint32_t> > > m_tables;
+
+  std::vector<uint64_t> m_hashes;
+};
+
+} // close namespace urjc
+
+#endif /* HASHINDEX_HPP */
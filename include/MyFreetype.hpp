@@ -15,13 +15,80 @@
 // ----------------------- INCLUDES --------------------------------------------
 #include <string>
 #include <vector>
+#include <stdint.h>
 #include <opencv/cv.h>
+#include <operations.hpp>
+#include <Degradation.hpp>
+#include <Budget.hpp>
+#include <Statistics.hpp>
+#include <GlyphStore.hpp>
+#include <Topology.hpp>
+#include <WorkerPool.hpp>
 #include <freetype2/ft2build.h>
 #include FT_FREETYPE_H
 #include FT_STROKER_H
 
 namespace urjc {
 
+/**
+ * @brief Character size in points and resolution in dots per inch.
+ */
+struct CharSize
+{
+  CharSize(unsigned s, unsigned d) : size(s), dpi(d) {};
+  unsigned size, dpi;
+};
+
+/**
+ * @brief Origin of an image and parameters of its transformations.
+ */
+struct SampleInfo
+{
+  SampleInfo() : font(0), angle(0), repeat(0), line(0) {};
+  unsigned short font;
+  short angle;
+  unsigned repeat;
+  // Text line of the crop plus one, zero for isolated glyphs
+  unsigned line;
+  Augmentation augmentation;
+};
+
+/**
+ * @brief Rendered text line with the index and bounding box of each
+ * character.
+ */
+struct TextLine
+{
+  unsigned size;
+  cv::Mat image;
+  std::vector<unsigned> characters;
+  std::vector<cv::Rect> boxes;
+};
+
+/**
+ * @brief Work done by the workers of a memory node.
+ */
+struct NodeMetrics
+{
+  NodeMetrics() : samples(0), stolen(0), encoded(0), transform_seconds(0), encode_seconds(0) {};
+  // Classes taken from other nodes once this one ran out of work
+  unsigned samples, stolen, encoded;
+  double transform_seconds, encode_seconds;
+};
+
+/**
+ * @brief Work counters of a generation run.
+ */
+struct Metrics
+{
+  Metrics() : faces(0), outlines(0), bitmaps(0), samples(0), resampled(0), dropped(0), bytes(0) {};
+  unsigned faces, outlines, bitmaps, samples, resampled, dropped;
+  // Encoded bytes of the saved images
+  uint64_t bytes;
+  // Per memory node if workers are pinned
+  std::vector<NodeMetrics> nodes;
+};
+
 /** ****************************************************************************
  * @class MyFreetype
  * @brief A class that use Freetype library to generate images.
@@ -32,7 +99,7 @@ public:
 
   // Constructor
   MyFreetype
-    () {};
+    ();
 
   // Destroyer
   ~MyFreetype
@@ -47,6 +114,177 @@ public:
     std::vector<unsigned> &characters
     );
 
+  /**
+   * @brief Look up the characters in the character map of each font. By
+   * default they are glyph indices in the Macintosh standard order.
+   */
+  void
+  setCharacterMap
+    (
+    const bool char_map
+    );
+
+  /**
+   * @brief Set the list of sizes rendered from each glyph outline.
+   */
+  void
+  setCharacterSizes
+    (
+    std::vector<CharSize> &sizes
+    );
+
+  /**
+   * @brief Discard transformed images whose perceptual hash is within this
+   * Hamming distance of a previous image of the same character. A negative
+   * distance disables the deduplication.
+   */
+  void
+  setDeduplication
+    (
+    const int max_distance
+    );
+
+  /**
+   * @brief Distribute the same total number of samples from the classifier
+   * errors instead of repeating each image the same number of times.
+   */
+  void
+  setBudget
+    (
+    const Budget &budget
+    );
+
+  /**
+   * @brief Keep a signed distance field of each rendered glyph, so scale and
+   * stroke weight are sampled from it instead of resampling the bitmap and
+   * applying morphology.
+   */
+  void
+  setDistanceFields
+    (
+    const bool sdf
+    );
+
+  /**
+   * @brief Pin the transformation and encoding workers to the processors of
+   * each memory node, giving every node its own classes and glyphs.
+   */
+  void
+  setNumaAffinity
+    (
+    const bool numa
+    );
+
+  /**
+   * @brief Rasterize each glyph also at this factor of its resolution, so
+   * its scale and sub-pixel translation average areas of that bitmap instead
+   * of interpolating the antialiased one. Zero disables it.
+   */
+  void
+  setSupersampling
+    (
+    const unsigned factor
+    );
+
+  /**
+   * @brief Keep the rendered glyphs cropped and run-length encoded with this
+   * number of bits per pixel (8 lossless or 4), decoding each one right before
+   * its transformations. Zero keeps a matrix per glyph.
+   */
+  void
+  setCompactGlyphs
+    (
+    const unsigned bits
+    );
+
+  /**
+   * @brief Degrade the transformed images with motion and defocus blur,
+   * sensor noise and JPEG recompression.
+   */
+  void
+  setDegradation
+    (
+    const bool degrade
+    );
+
+  /**
+   * @brief Number of threads that transform and encode the images. Rendering
+   * uses a single thread.
+   */
+  void
+  setThreads
+    (
+    const unsigned transform_threads,
+    const unsigned encode_threads
+    );
+
+  /**
+   * @brief Number of images encoded in parallel before they are written.
+   */
+  void
+  setBatchSize
+    (
+    const unsigned batch_size
+    );
+
+  /**
+   * @brief PNG compression level from 0 to 9.
+   */
+  void
+  setCompression
+    (
+    const int compression
+    );
+
+  int
+  getCompression
+    () const { return m_compression; };
+
+  /**
+   * @brief Save images into tar archives of this maximum size instead of a
+   * file per image. Zero keeps a file per image.
+   */
+  void
+  setOutputShards
+    (
+    const size_t max_bytes
+    );
+
+  /**
+   * @brief Write the samples into tar archives in a global random order drawn
+   * from the seed, spilling them into buckets of at most this many bytes.
+   * Zero keeps them grouped by class.
+   */
+  void
+  setOutputShuffle
+    (
+    const size_t max_bytes
+    );
+
+  /**
+   * @brief Render this number of random text lines per font and size. Each
+   * character of a line is also cropped with its neighbours as a new image.
+   */
+  void
+  setTextLines
+    (
+    const unsigned num_lines,
+    const unsigned length
+    );
+
+  /**
+   * @brief Seed of the random transformations, the current time by default.
+   */
+  void
+  setSeed
+    (
+    const uint64_t seed
+    );
+
+  uint64_t
+  getSeed
+    () const { return m_seed; };
+
   /**
    * @brief Generate a list of synthetic images using a True Type font.
    */
@@ -64,7 +302,8 @@ public:
     ();
 
   /**
-   * @brief Save synthetic images in the output directory.
+   * @brief Save synthetic images in the output directory, together with a
+   * 'provenance.col' table with the origin and random parameters of each one.
    */
   void
   saveImages
@@ -72,11 +311,209 @@ public:
     const char *output_dir
     );
 
+  /**
+   * @brief Transform and save the images in parts until every sample is
+   * written or a limit is reached. Samples follow a round robin over every
+   * image of every class weighted by its budget, so any prefix is balanced. A
+   * checkpoint after each part lets the next run continue where this one
+   * stopped.
+   */
+  bool
+  generateBudgeted
+    (
+    const std::string &output_dir,
+    const size_t max_samples,
+    const double max_seconds
+    );
+
+  /**
+   * @brief Work done since the creation of this object.
+   */
+  const Metrics&
+  getMetrics
+    () const { return m_metrics; };
+
+  /**
+   * @brief Images of each size and character.
+   */
+  const std::vector< std::vector<cv::Mat> >&
+  getImages
+    () const { return m_images; };
+
+  /**
+   * @brief Rendered images of each size and character, decoded from the
+   * compact store if it is used.
+   */
+  void
+  getBaseImages
+    (
+    std::vector< std::vector<cv::Mat> > &images
+    ) const;
+
+  /**
+   * @brief Bytes of the images and distance fields held in memory.
+   */
+  size_t
+  memoryUsage
+    () const;
+
 private:
 
   /**
-   * @brief Create a set of images with different rotations from the
-   * character associated to this index.
+   * @brief Apply the chain of random algorithm operations to an image.
+   */
+  void
+  transformImage
+    (
+    cv::RNG &rng,
+    const cv::Mat &sdf,
+    const cv::Mat &master,
+    Degradation &degradation,
+    cv::Mat &img,
+    Augmentation &aug
+    );
+
+  /**
+   * @brief Keep a rendered image of a class, in the compact store if it is
+   * used.
+   */
+  void
+  storeImage
+    (
+    const unsigned i,
+    const cv::Mat &image
+    );
+
+  /**
+   * @brief Rendered image 'k' of class 'i', decoded into the scratch buffer
+   * if the compact store is used.
+   */
+  cv::Mat
+  baseImage
+    (
+    const unsigned i,
+    const unsigned k,
+    const GlyphStore &store,
+    const std::vector<cv::Mat> &images,
+    cv::Mat &scratch
+    ) const;
+
+  /**
+   * @brief Replace the rendered images of every class by their repeats from
+   * 'first' to 'last'.
+   */
+  void
+  transformRepeats
+    (
+    const std::vector< std::vector<unsigned> > &first,
+    const std::vector< std::vector<unsigned> > &last
+    );
+
+  /**
+   * @brief Replace the rendered images of a class by their transformations.
+   */
+  void
+  transformClass
+    (
+    const unsigned i,
+    const std::vector<unsigned> &first,
+    const std::vector<unsigned> &last,
+    const GlyphStore &store,
+    Degradation &degradation,
+    Statistics &statistics,
+    Metrics &metrics
+    );
+
+  /**
+   * @brief Encode a range of images as PNG files in parallel with the
+   * threads of a pool, on the processors of a memory node if workers are
+   * pinned.
+   */
+  void
+  encodeImages
+    (
+    WorkerPool &pool,
+    const std::vector<cv::Mat> &images,
+    const unsigned first,
+    const unsigned last,
+    const unsigned node,
+    std::vector< std::vector<uchar> > &buffers,
+    const std::vector<int> &params
+    ) const;
+
+  /**
+   * @brief Coverage of a glyph outline rendered 'scale' times bigger and
+   * aligned with its bitmap.
+   */
+  cv::Mat
+  glyphCoverage
+    (
+    FT_Glyph glyph,
+    const int left,
+    const int top,
+    const cv::Size &size,
+    const unsigned scale
+    ) const;
+
+  /**
+   * @brief Oversampled signed distance field of a glyph outline aligned with
+   * its bitmap.
+   */
+  cv::Mat
+  glyphDistanceField
+    (
+    FT_Glyph glyph,
+    const int left,
+    const int top,
+    const cv::Size &size
+    ) const;
+
+  /**
+   * @brief Lay out random strings with the font advances and kerning, render
+   * each line at once and crop its characters.
+   */
+  void
+  writeTextLines
+    (
+    FT_Library &library,
+    FT_Face &face
+    );
+
+  /**
+   * @brief Write the progress of a budgeted run, replacing the previous
+   * file only once the new one is complete and on disk.
+   */
+  bool
+  saveCheckpoint
+    (
+    const std::string &filename,
+    const std::string &output_dir,
+    const size_t units,
+    const size_t done,
+    const unsigned parts
+    ) const;
+
+  /**
+   * @brief Number of transformed samples of each rendered image.
+   */
+  void
+  sampleBudget
+    (
+    std::vector< std::vector<unsigned> > &repeats
+    ) const;
+
+  /**
+   * @brief Write the provenance table of every saved image.
+   */
+  void
+  saveProvenance
+    (
+    const std::string &filename
+    );
+
+  /**
+   * @brief Create a set of images with different sizes and rotations from
+   * the character associated to this index.
    */
   void
   writeGlyphAsBitmap
@@ -88,8 +525,74 @@ private:
   // Set digits + uppers + lowers + delimiter
   std::vector<unsigned> m_characters;
 
-  // For each character store images with different fonts and rotations
+  // Glyph index of each character in the current font
+  bool m_char_map;
+  std::vector<FT_UInt> m_glyphs;
+
+  // Sizes rendered for each character
+  std::vector<CharSize> m_sizes;
+
+  // For each size and character store images with different fonts and
+  // rotations. Images of size 's' and character 'c' are stored in the index
+  // 's*m_characters.size() + c'
   std::vector< std::vector<cv::Mat> > m_images;
+
+  // Origin and parameters of each image
+  std::vector< std::vector<SampleInfo> > m_infos;
+
+  // Rendered images of each class in the compact store, which leaves
+  // 'm_images' empty until the transformations
+  bool m_compact;
+  GlyphStore m_store;
+  std::vector< std::vector<unsigned> > m_tiles;
+
+  // Signed distance field of each image, empty for the text line crops
+  bool m_sdf;
+  std::vector< std::vector<cv::Mat> > m_sdfs;
+
+  // Supersampled bitmap of each image, empty for the text line crops
+  unsigned m_supersample;
+  std::vector< std::vector<cv::Mat> > m_masters;
+
+  // Name of each font file
+  std::vector<std::string> m_fonts;
+
+  // Number of text lines per font and size and characters per line
+  unsigned m_num_lines, m_line_length;
+  std::vector<TextLine> m_lines;
+
+  Metrics m_metrics;
+
+  // Statistics of the transformed images of each class
+  Statistics m_statistics;
+
+  // Maximum Hamming distance between near-duplicated images
+  int m_max_distance;
+
+  // Maximum size of each output tar archive
+  size_t m_shard_size;
+
+  // Maximum size of each shuffle bucket
+  size_t m_shuffle_size;
+
+  // Workers pinned to the memory nodes, and node of the workers that
+  // transformed each class
+  bool m_numa;
+  Topology m_topology;
+  std::vector<unsigned> m_class_nodes;
+
+  // Threads of each stage, images per encoding batch and PNG compression
+  unsigned m_transform_threads, m_encode_threads, m_batch_size;
+  int m_compression;
+
+  uint64_t m_seed;
+
+  // Classifier errors that distribute the samples
+  Budget m_budget;
+
+  // Scanner and camera degradations
+  bool m_degrade;
+  Degradation m_degradation;
 };
 
 }; // close namespace urjc
@@ -0,0 +1,82 @@
+/** ****************************************************************************
+ *  @file    Profiler.hpp
+ *  @brief   Hardware performance counters of each stage and thread.
+ *  @author  Roberto Valle Fernandez.
+ *  @date    2012/01
+ *  @copyright All rights reserved.
+ *  Escuela Tecnica Superior de Ingenieria Informatica (Computer Science School)
+ *  Universidad Rey Juan Carlos (Spain)
+ ******************************************************************************/
+
+// ------------------ RECURSION PROTECTION -------------------------------------
+#ifndef PROFILER_HPP
+#define PROFILER_HPP
+
+// ----------------------- INCLUDES --------------------------------------------
+#include <string>
+#include <stdint.h>
+
+namespace urjc {
+
+// Cycles, instructions, cache misses, branch misses and page faults
+const unsigned PROFILE_EVENTS = 5;
+
+/**
+ * @brief Open the counters of the calling thread to check they are allowed,
+ * each thread opens its own counters on its first stage.
+ */
+bool
+enableProfiling
+  ();
+
+/**
+ * @brief Report the counters of the calling thread as this worker, the
+ * main thread is 0.
+ */
+void
+setProfileThread
+  (
+  const unsigned index
+  );
+
+/**
+ * @brief Write a text table with the counters of each stage and thread.
+ */
+bool
+saveProfile
+  (
+  const std::string &filename
+  );
+
+/** ****************************************************************************
+ * @class ProfileScope
+ * @brief Adds the counters of the calling thread between its construction
+ * and destruction to a stage. Scopes may be nested, so a stage includes the
+ * stages it calls. Does nothing unless profiling is enabled.
+ ******************************************************************************/
+class ProfileScope
+{
+public:
+
+  // Constructor
+  ProfileScope
+    (
+    const char *stage,
+    const unsigned samples = 1
+    );
+
+  // Destroyer
+  ~ProfileScope
+    ();
+
+private:
+
+  const char *m_stage;
+  unsigned m_samples;
+  bool m_active;
+  uint64_t m_start[PROFILE_EVENTS];
+};
+
+} // close namespace urjc
+
+#endif /* PROFILER_HPP */
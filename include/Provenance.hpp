@@ -0,0 +1,149 @@
+/** ****************************************************************************
+ *  @file    Provenance.hpp
+ *  @brief   Columnar table with the origin and parameters of each sample.
+ *  @author  Roberto Valle Fernandez.
+ *  @date    2012/01
+ *  @copyright All rights reserved.
+ *  Escuela Tecnica Superior de Ingenieria Informatica (Computer Science School)
+ *  Universidad Rey Juan Carlos (Spain)
+ ******************************************************************************/
+
+// ------------------ RECURSION PROTECTION -------------------------------------
+#ifndef PROVENANCE_HPP
+#define PROVENANCE_HPP
+
+// ----------------------- INCLUDES --------------------------------------------
+#include <string>
+#include <vector>
+#include <cstring>
+#include <stdint.h>
+
+namespace urjc {
+
+/** ****************************************************************************
+ * @class Provenance
+ * @brief Table of fixed width columns stored one after the other in a binary
+ * file, so that a column can be read or mapped without the others. Column
+ * types follow the Python struct codes: 'B' uint8, 'b' int8, 'H' uint16,
+ * 'I' uint32 and 'f' float. Fonts are stored once in a dictionary and the
+ * 'font' column holds their index.
+ *
+ * File layout (little endian): "GDBP", uint32 version, uint64 rows, uint32
+ * fonts, each font as uint32 length and characters, uint32 columns, each
+ * column as uint32 length, name, char type and uint64 data offset, then the
+ * data of each column aligned to 8 bytes.
+ ******************************************************************************/
+class Provenance
+{
+public:
+
+  // Constructor
+  Provenance
+    () : m_rows(0) {};
+
+  // Destroyer
+  ~Provenance
+    () {};
+
+  /**
+   * @brief Add an empty column and returns its index.
+   */
+  unsigned
+  addColumn
+    (
+    const std::string &name,
+    const char type
+    );
+
+  /**
+   * @brief Append a value to a column, it must have the column type.
+   */
+  template<typename T>
+  void
+  append
+    (
+    const unsigned col,
+    const T value
+    )
+  {
+    std::vector<unsigned char> &data = m_data[col];
+    data.resize(data.size() + sizeof(T));
+    memcpy(&data[data.size() - sizeof(T)], &value, sizeof(T));
+  };
+
+  /**
+   * @brief Finish a row once every column has its value.
+   */
+  void
+  endRow
+    () { m_rows++; };
+
+  void
+  setFonts
+    (
+    const std::vector<std::string> &fonts
+    ) { m_fonts = fonts; };
+
+  const std::vector<std::string>&
+  getFonts
+    () const { return m_fonts; };
+
+  size_t
+  numRows
+    () const { return m_rows; };
+
+  /**
+   * @brief Returns the index of a column or -1 if it doesn't exist.
+   */
+  int
+  findColumn
+    (
+    const std::string &name
+    ) const;
+
+  /**
+   * @brief Returns the value of a column in a row.
+   */
+  double
+  value
+    (
+    const unsigned col,
+    const size_t row
+    ) const;
+
+  /**
+   * @brief Clear the mask of the rows whose value of this column is out of
+   * the [min, max] range. The mask is initialized to ones if it is empty.
+   */
+  void
+  filter
+    (
+    const std::string &name,
+    const double min,
+    const double max,
+    std::vector<unsigned char> &mask
+    ) const;
+
+  bool
+  load
+    (
+    const std::string &filename
+    );
+
+  bool
+  save
+    (
+    const std::string &filename
+    ) const;
+
+private:
+
+  size_t m_rows;
+  std::vector<std::string> m_fonts, m_names;
+  std::vector<char> m_types;
+  std::vector< std::vector<unsigned char> > m_data;
+};
+
+} // close namespace urjc
+
+#endif /* PROVENANCE_HPP */
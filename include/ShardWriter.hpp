@@ -0,0 +1,93 @@
+/** ****************************************************************************
+ *  @file    ShardWriter.hpp
+ *  @brief   Write samples sequentially into size bounded tar archives.
+ *  @author  Roberto Valle Fernandez.
+ *  @date    2012/01
+ *  @copyright All rights reserved.
+ *  Escuela Tecnica Superior de Ingenieria Informatica (Computer Science School)
+ *  Universidad Rey Juan Carlos (Spain)
+ ******************************************************************************/
+
+// ------------------ RECURSION PROTECTION -------------------------------------
+#ifndef SHARDWRITER_HPP
+#define SHARDWRITER_HPP
+
+// ----------------------- INCLUDES --------------------------------------------
+#include <string>
+#include <vector>
+#include <fstream>
+
+namespace urjc {
+
+/** ****************************************************************************
+ * @class ShardWriter
+ * @brief Stores each sample as a '<key>.png' and '<key>.cls' pair of members
+ * of a 'shard-NNNNNN.tar' archive (WebDataset layout). A new shard starts when
+ * the current one would grow over the maximum size. Each shard has a
+ * 'shard-NNNNNN.idx' text file with a '<key> <offset> <size> <label>' line per
+ * sample, where offset and size locate the image data inside the archive.
+ ******************************************************************************/
+class ShardWriter
+{
+public:
+
+  // Constructor
+  ShardWriter
+    (
+    const std::string &output_dir,
+    const size_t max_bytes
+    );
+
+  // Destroyer
+  ~ShardWriter
+    ();
+
+  /**
+   * @brief Append an encoded image and its label to the current shard. Returns
+   * false and skips the sample if its key doesn't fit a ustar header.
+   */
+  bool
+  write
+    (
+    const std::string &key,
+    const std::vector<unsigned char> &image,
+    const std::string &label,
+    const std::string &label_ext = "cls"
+    );
+
+  /**
+   * @brief Finish the current shard.
+   */
+  void
+  close
+    ();
+
+  /**
+   * @brief Number of shards written.
+   */
+  unsigned
+  numShards
+    () const { return m_shard; };
+
+private:
+
+  /**
+   * @brief Write a tar header followed by the data and its padding.
+   */
+  void
+  writeMember
+    (
+    const std::string &member,
+    const char *data,
+    const size_t size
+    );
+
+  std::string m_output_dir;
+  size_t m_max_bytes, m_offset;
+  unsigned m_shard;
+  std::ofstream m_tar, m_index;
+};
+
+} // close namespace urjc
+
+#endif /* SHARDWRITER_HPP */
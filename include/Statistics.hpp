@@ -0,0 +1,124 @@
+/** ****************************************************************************
+ *  @file    Statistics.hpp
+ *  @brief   Online statistics of the generated images of each class.
+ *  @author  Roberto Valle Fernandez.
+ *  @date    2012/01
+ *  @copyright All rights reserved.
+ *  Escuela Tecnica Superior de Ingenieria Informatica (Computer Science School)
+ *  Universidad Rey Juan Carlos (Spain)
+ ******************************************************************************/
+
+// ------------------ RECURSION PROTECTION -------------------------------------
+#ifndef STATISTICS_HPP
+#define STATISTICS_HPP
+
+// ----------------------- INCLUDES --------------------------------------------
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <opencv/cv.h>
+
+namespace urjc {
+
+/**
+ * @brief Count, mean and sum of squared deviations of a set of values. Two
+ * sets are merged with the parallel update of Chan et al.
+ */
+struct Moments
+{
+  Moments() : count(0), mean(0.0), m2(0.0), min(0.0), max(0.0) {};
+  uint64_t count;
+  double mean, m2, min, max;
+
+  void
+  add
+    (
+    const double value
+    );
+
+  void
+  merge
+    (
+    const Moments &other
+    );
+
+  double
+  variance
+    () const { return (count > 0) ? m2 / count : 0.0; };
+};
+
+/**
+ * @brief Statistics of the images of a class: pixel intensities, image sizes
+ * and fraction of ink pixels of each image.
+ */
+struct ClassStatistics
+{
+  Moments pixels, width, height, ink;
+
+  void
+  add
+    (
+    const cv::Mat &img
+    );
+
+  void
+  merge
+    (
+    const ClassStatistics &other
+    );
+};
+
+/** ****************************************************************************
+ * @class Statistics
+ * @brief Per class accumulators updated while the samples are generated. Each
+ * worker keeps its own accumulators and merges them at the end, so the images
+ * are never read again to normalize the dataset.
+ ******************************************************************************/
+class Statistics
+{
+public:
+
+  // Constructor
+  Statistics
+    (
+    const unsigned num_classes = 0
+    ) : m_classes(num_classes) {};
+
+  // Destroyer
+  ~Statistics
+    () {};
+
+  void
+  add
+    (
+    const unsigned cls,
+    const cv::Mat &img
+    ) { m_classes[cls].add(img); };
+
+  /**
+   * @brief Merge the accumulators of another worker with the same classes.
+   */
+  void
+  merge
+    (
+    const Statistics &other
+    );
+
+  /**
+   * @brief Write a text table with a row per class and a last 'all' row.
+   */
+  bool
+  save
+    (
+    const std::string &filename,
+    const std::vector<std::string> &names
+    ) const;
+
+private:
+
+  std::vector<ClassStatistics> m_classes;
+};
+
+} // close namespace urjc
+
+#endif /* STATISTICS_HPP */
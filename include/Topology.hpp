@@ -0,0 +1,99 @@
+/** ****************************************************************************
+ *  @file    Topology.hpp
+ *  @brief   Memory nodes of the machine and thread affinity.
+ *  @author  Roberto Valle Fernandez.
+ *  @date    2012/01
+ *  @copyright All rights reserved.
+ *  Escuela Tecnica Superior de Ingenieria Informatica (Computer Science School)
+ *  Universidad Rey Juan Carlos (Spain)
+ ******************************************************************************/
+
+// ------------------ RECURSION PROTECTION -------------------------------------
+#ifndef TOPOLOGY_HPP
+#define TOPOLOGY_HPP
+
+// ----------------------- INCLUDES --------------------------------------------
+#include <string>
+#include <vector>
+
+namespace urjc {
+
+/** ****************************************************************************
+ * @class Topology
+ * @brief NUMA nodes read from sysfs with the processors this process may run
+ * on. Workers are spread round robin over the nodes, so any number of threads
+ * uses the memory bandwidth of every socket, and each one gets its own core.
+ ******************************************************************************/
+class Topology
+{
+public:
+
+  // Constructor
+  Topology
+    ();
+
+  // Destroyer
+  ~Topology
+    () {};
+
+  /**
+   * @brief Number of nodes with at least one allowed processor.
+   */
+  unsigned
+  size
+    () const { return m_cpus.size(); };
+
+  /**
+   * @brief Allowed processors of a node.
+   */
+  const std::vector<unsigned>&
+  cpus
+    (
+    const unsigned node
+    ) const { return m_cpus[node]; };
+
+  /**
+   * @brief Node of worker 't'.
+   */
+  unsigned
+  workerNode
+    (
+    const unsigned t
+    ) const { return t % m_cpus.size(); };
+
+  /**
+   * @brief Processor of worker 't'.
+   */
+  unsigned
+  workerCpu
+    (
+    const unsigned t
+    ) const;
+
+  /**
+   * @brief Restrict the calling thread to these processors.
+   */
+  static bool
+  pinThread
+    (
+    const std::vector<unsigned> &cpus
+    );
+
+private:
+
+  std::vector< std::vector<unsigned> > m_cpus;
+};
+
+/**
+ * @brief Processors of a sysfs list such as '0-7,16-23'.
+ */
+void
+parseCpuList
+  (
+  const std::string &list,
+  std::vector<unsigned> &cpus
+  );
+
+} // close namespace urjc
+
+#endif /* TOPOLOGY_HPP */
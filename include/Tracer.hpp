@@ -0,0 +1,97 @@
+/** ****************************************************************************
+ *  @file    Tracer.hpp
+ *  @brief   Timeline of the pipeline in per-thread ring buffers.
+ *  @author  Roberto Valle Fernandez.
+ *  @date    2012/01
+ *  @copyright All rights reserved.
+ *  Escuela Tecnica Superior de Ingenieria Informatica (Computer Science School)
+ *  Universidad Rey Juan Carlos (Spain)
+ ******************************************************************************/
+
+// ------------------ RECURSION PROTECTION -------------------------------------
+#ifndef TRACER_HPP
+#define TRACER_HPP
+
+// ----------------------- INCLUDES --------------------------------------------
+#include <string>
+#include <stdint.h>
+
+// Scopes above 'TRACE_LEVEL' are removed at compile time
+#define TRACE_STAGES 1
+#define TRACE_GLYPHS 2
+#define TRACE_SAMPLES 3
+#ifndef TRACE_LEVEL
+  #define TRACE_LEVEL TRACE_GLYPHS
+#endif
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(...) urjc::TraceScope TRACE_CONCAT(trace_scope_, __LINE__)(__VA_ARGS__)
+
+#if TRACE_LEVEL >= TRACE_STAGES
+  #define TRACE_STAGE(...) TRACE_SCOPE(__VA_ARGS__)
+#else
+  #define TRACE_STAGE(...)
+#endif
+#if TRACE_LEVEL >= TRACE_GLYPHS
+  #define TRACE_GLYPH(...) TRACE_SCOPE(__VA_ARGS__)
+#else
+  #define TRACE_GLYPH(...)
+#endif
+#if TRACE_LEVEL >= TRACE_SAMPLES
+  #define TRACE_SAMPLE(...) TRACE_SCOPE(__VA_ARGS__)
+#else
+  #define TRACE_SAMPLE(...)
+#endif
+
+namespace urjc {
+
+/**
+ * @brief Start recording the scopes of every thread.
+ */
+void
+enableTracing
+  ();
+
+/**
+ * @brief Write the recorded scopes as a Chrome trace (chrome://tracing or
+ * ui.perfetto.dev). Call it once the workers have finished.
+ */
+bool
+saveTrace
+  (
+  const std::string &filename
+  );
+
+/** ****************************************************************************
+ * @class TraceScope
+ * @brief Records its lifetime as one event of the calling thread. Each thread
+ * owns a ring buffer that only it writes, so recording takes no lock and
+ * keeps the most recent events. Does nothing unless tracing is enabled.
+ ******************************************************************************/
+class TraceScope
+{
+public:
+
+  // Constructor
+  TraceScope
+    (
+    const char *name,
+    const uint32_t id = 0
+    );
+
+  // Destroyer
+  ~TraceScope
+    ();
+
+private:
+
+  const char *m_name;
+  uint32_t m_id;
+  bool m_active;
+  uint64_t m_start;
+};
+
+} // close namespace urjc
+
+#endif /* TRACER_HPP */
@@ -0,0 +1,77 @@
+/** ****************************************************************************
+ *  @file    WorkerPool.hpp
+ *  @brief   Threads started once and reused for every batch of work.
+ *  @author  Roberto Valle Fernandez.
+ *  @date    2012/01
+ *  @copyright All rights reserved.
+ *  Escuela Tecnica Superior de Ingenieria Informatica (Computer Science School)
+ *  Universidad Rey Juan Carlos (Spain)
+ ******************************************************************************/
+
+// ------------------ RECURSION PROTECTION -------------------------------------
+#ifndef WORKERPOOL_HPP
+#define WORKERPOOL_HPP
+
+// ----------------------- INCLUDES --------------------------------------------
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <functional>
+#include <condition_variable>
+
+namespace urjc {
+
+/** ****************************************************************************
+ * @class WorkerPool
+ * @brief Fixed set of threads that run the same job with their own index,
+ * one job at a time, and sleep between jobs. Threads keep their state (thread
+ * locals, affinity, counters) from one job to the next.
+ ******************************************************************************/
+class WorkerPool
+{
+public:
+
+  // Constructor
+  WorkerPool
+    (
+    const unsigned num_threads
+    );
+
+  // Destroyer
+  ~WorkerPool
+    ();
+
+  unsigned
+  size
+    () const { return m_workers.size(); };
+
+  /**
+   * @brief Run 'job(t)' on every thread 't' and return once all are done.
+   */
+  void
+  run
+    (
+    const std::function<void (unsigned)> &job
+    );
+
+private:
+
+  void
+  work
+    (
+    const unsigned t
+    );
+
+  std::vector<std::thread> m_workers;
+  std::mutex m_mutex;
+  std::condition_variable m_condition;
+  const std::function<void (unsigned)> *m_job;
+  // Number of jobs started, and threads still running the last one
+  unsigned m_generation;
+  unsigned m_running;
+  bool m_stop;
+};
+
+} // close namespace urjc
+
+#endif /* WORKERPOOL_HPP */
@@ -17,6 +17,23 @@
 
 namespace urjc {
 
+/**
+ * @brief Random parameters drawn by the transformations of an image.
+ */
+struct Augmentation
+{
+  Augmentation() : scale(1.0f), tx(0.0f), ty(0.0f), blur(0), morphology(2), anisotropic(0), psf(0), noise(0), jpeg(0), weight(0.0f) {};
+  float scale, tx, ty;
+  // Blur kernel size (0 without blur), morphology operator (0 erosion,
+  // 1 dilation, 2 none) and anisotropic filter (0 or 1)
+  unsigned char blur, morphology, anisotropic;
+  // Degradation point spread function and noise bank entries plus one, and
+  // JPEG quality (0 when not applied)
+  unsigned char psf, noise, jpeg;
+  // Stroke offset in pixels of the distance field transformation
+  float weight;
+};
+
 /**
  * @brief Applies an affine transformation to an image.
  */
@@ -24,7 +41,49 @@ void
 affineTransform
   (
   cv::RNG &rng,
-  cv::Mat &img
+  cv::Mat &img,
+  Augmentation &aug
+  );
+
+/**
+ * @brief Scales and translates an 8 bits image about its origin with the
+ * same result as 'cv::warpAffine' with bilinear interpolation and a zero
+ * border, in two separable passes.
+ */
+void
+scaleTranslate
+  (
+  const cv::Mat &src,
+  cv::Mat &dst,
+  const float scale,
+  const float tx,
+  const float ty
+  );
+
+/**
+ * @brief Applies an affine transformation and a stroke weight change by
+ * sampling a signed distance field.
+ */
+void
+distanceFieldTransform
+  (
+  cv::RNG &rng,
+  const cv::Mat &sdf,
+  cv::Mat &img,
+  Augmentation &aug
+  );
+
+/**
+ * @brief Applies the same scale and sub-pixel translation as the affine
+ * transformation by averaging areas of a supersampled bitmap.
+ */
+void
+supersampledTransform
+  (
+  cv::RNG &rng,
+  const cv::Mat &master,
+  cv::Mat &img,
+  Augmentation &aug
   );
 
 /**
@@ -34,7 +93,8 @@ void
 smoothTransform
   (
   cv::RNG &rng,
-  cv::Mat &img
+  cv::Mat &img,
+  Augmentation &aug
   );
 
 /**
@@ -44,7 +104,8 @@ void
 morphologicTransform
   (
   cv::RNG &rng,
-  cv::Mat &img
+  cv::Mat &img,
+  Augmentation &aug
   );
 
 /**
@@ -64,7 +125,8 @@ void
 anisotropicFilter
   (
   cv::RNG &rng,
-  cv::Mat &img
+  cv::Mat &img,
+  Augmentation &aug
   );
 
 cv::Mat
@@ -81,7 +143,18 @@ anisotropicSmooth
   cv::Mat &dst,
   cv::Mat &kernel
   );
-  
+
+/**
+ * @brief Equalized ratio between an image and its anisotropic smooth.
+ */
+void
+anisotropicEqualize
+  (
+  const cv::Mat &img,
+  const cv::Mat &smoothed,
+  cv::Mat &dst
+  );
+
 }; // close namespace urjc
 
 #endif /* OPERATIONS_HPP */
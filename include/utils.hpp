@@ -14,6 +14,8 @@
 
 // ----------------------- INCLUDES --------------------------------------------
 #include <string>
+#include <iostream>
+#include <stdint.h>
 
 namespace urjc {
 
@@ -35,6 +37,95 @@ string2AsciiCode
   const std::string character
   );
 
+/**
+ *  @brief Returns the Unicode code point of the first character of a UTF-8
+ *  string, zero if it is empty.
+ */
+unsigned
+utf8CodePoint
+  (
+  const std::string &character
+  );
+
+/**
+ *  @brief Returns the random seed of a sample from a global seed, the index of
+ *  its images list and its position in that list.
+ */
+uint64_t
+sampleSeed
+  (
+  const uint64_t seed,
+  const unsigned idx,
+  const unsigned sample
+  );
+
+/**
+ *  @brief Write a value in a binary stream.
+ */
+template<typename T>
+void
+writeValue
+  (
+  std::ostream &os,
+  const T &value
+  )
+{
+  os.write(reinterpret_cast<const char*>(&value), sizeof(T));
+};
+
+/**
+ *  @brief Read a value written by writeValue.
+ */
+template<typename T>
+void
+readValue
+  (
+  std::istream &is,
+  T &value
+  )
+{
+  is.read(reinterpret_cast<char*>(&value), sizeof(T));
+};
+
+/**
+ *  @brief Write a string in a binary stream after its 32 bits length.
+ */
+void
+writeString
+  (
+  std::ostream &os,
+  const std::string &str
+  );
+
+/**
+ *  @brief Read a string written by writeString.
+ */
+void
+readString
+  (
+  std::istream &is,
+  std::string &str
+  );
+
+/**
+ *  @brief Flush a file or a directory entry to the disk.
+ */
+bool
+syncPath
+  (
+  const std::string &path
+  );
+
+/**
+ *  @brief Flush every file and directory under a directory, and the directory
+ *  itself, to the disk.
+ */
+bool
+syncDirectory
+  (
+  const std::string &path
+  );
+
 }; // close namespace urjc
 
 #endif /* UTILS_HPP */
@@ -0,0 +1,181 @@
+/** ****************************************************************************
+ *  @file    Budget.cpp
+ *  @brief   Distribute the generated samples from the classifier errors.
+ *  @author  Roberto Valle Fernandez.
+ *  @date    2012/01
+ *  @copyright All rights reserved.
+ *  Escuela Tecnica Superior de Ingenieria Informatica (Computer Science School)
+ *  Universidad Rey Juan Carlos (Spain)
+ ******************************************************************************/
+
+// ----------------------- INCLUDES --------------------------------------------
+#include <Budget.hpp>
+#include <Constants.hpp>
+#include <trace.hpp>
+#include <cmath>
+#include <utility>
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <stdint.h>
+
+namespace urjc {
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method: the error of a character in a confusion matrix is the
+// number of its samples predicted as another character plus the number of
+// other samples predicted as it, divided by the size of its row and column.
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats: explicit error lines replace the errors computed
+// from the confusion matrix.
+//
+// -----------------------------------------------------------------------------
+bool
+Budget::load
+  (
+  const std::string &filename
+  )
+{
+  std::ifstream ifs(filename.c_str());
+  if (!ifs.is_open())
+  {
+    ERROR("Error. File " << filename << " can't be opened");
+    return false;
+  }
+
+  std::map<std::string, double> wrong, total;
+  std::map<std::string, double> errors;
+  std::string line;
+  while (std::getline(ifs, line))
+  {
+    std::stringstream ss(line);
+    std::vector<std::string> fields;
+    std::string field;
+    while (ss >> field)
+      fields.push_back(field);
+    if (fields.empty())
+      continue;
+
+    if ((fields[0].compare("confusion")==0) && (fields.size() == 4))
+    {
+      double count = atof(fields[3].c_str());
+      total[fields[1]] += count;
+      total[fields[2]] += count;
+      if (fields[1].compare(fields[2]) != 0)
+      {
+        wrong[fields[1]] += count;
+        wrong[fields[2]] += count;
+      }
+    }
+    else if ((fields[0].compare("error")==0) && (fields.size() == 3))
+      errors[fields[1]] = atof(fields[2].c_str());
+    else if ((fields[0].compare("error")==0) && (fields.size() == 4))
+      m_font_errors[fields[1] + " " + fields[2]] = atof(fields[3].c_str());
+    else
+    {
+      ERROR("Error. Unknown budget line: " << line);
+      return false;
+    }
+  }
+
+  for (std::map<std::string, double>::const_iterator it=total.begin(); it != total.end(); it++)
+    if (it->second > 0)
+      m_errors[it->first] = wrong[it->first] / it->second;
+  for (std::map<std::string, double>::const_iterator it=errors.begin(); it != errors.end(); it++)
+    m_errors[it->first] = it->second;
+  return true;
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method: a minimum weight keeps some samples of the characters
+// without errors.
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+double
+Budget::weight
+  (
+  const std::string &character,
+  const std::string &font
+  ) const
+{
+  std::map<std::string, double>::const_iterator it = m_font_errors.find(character + " " + font);
+  if (it != m_font_errors.end())
+    return Constants::BUDGET_FLOOR + it->second;
+  it = m_errors.find(character);
+  if (it != m_errors.end())
+    return Constants::BUDGET_FLOOR + it->second;
+  return Constants::BUDGET_FLOOR;
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method:
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+static bool
+compareRemainders
+  (
+  const std::pair<uint64_t, unsigned> &a,
+  const std::pair<uint64_t, unsigned> &b
+  )
+{
+  return a.first > b.first;
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method: largest remainder method in integer arithmetic, weights
+// are quantized so the result doesn't depend on the rounding of the platform.
+// Remainders are sorted once, ties go to the first weight.
+// Inputs:
+// Outputs: counts adding up to 'total'
+// Dependencies:
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+void
+Budget::allocate
+  (
+  const std::vector<double> &weights,
+  const unsigned total,
+  std::vector<unsigned> &counts
+  )
+{
+  counts.assign(weights.size(), 0);
+  std::vector<uint64_t> quantized(weights.size());
+  uint64_t sum = 0;
+  for (unsigned i=0; i < weights.size(); i++)
+  {
+    quantized[i] = static_cast<uint64_t>(floor(weights[i]*1e6 + 0.5));
+    sum += quantized[i];
+  }
+  if (sum == 0)
+    return;
+
+  std::vector< std::pair<uint64_t, unsigned> > remainders(weights.size());
+  unsigned assigned = 0;
+  for (unsigned i=0; i < weights.size(); i++)
+  {
+    counts[i] = static_cast<unsigned>((total*quantized[i]) / sum);
+    remainders[i] = std::make_pair((total*quantized[i]) % sum, i);
+    assigned += counts[i];
+  }
+  std::stable_sort(remainders.begin(), remainders.end(), compareRemainders);
+  for (unsigned i=0; assigned < total; i++, assigned++)
+    counts[remainders[i].second]++;
+}
+
+} // close namespace urjc
@@ -0,0 +1,233 @@
+/** ****************************************************************************
+ *  @file    Calibration.cpp
+ *  @brief   Choose the threads, batch size and compression level of a run.
+ *  @author  Roberto Valle Fernandez.
+ *  @date    2012/01
+ *  @copyright All rights reserved.
+ *  Escuela Tecnica Superior de Ingenieria Informatica (Computer Science School)
+ *  Universidad Rey Juan Carlos (Spain)
+ ******************************************************************************/
+
+// ----------------------- INCLUDES --------------------------------------------
+#include <Calibration.hpp>
+#include <Constants.hpp>
+#include <trace.hpp>
+#include <thread>
+#include <algorithm>
+#include <boost/filesystem.hpp>
+
+namespace urjc {
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method:
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+Calibration::Calibration
+  (
+  const std::string &fonts_dir,
+  const std::vector<std::string> &fonts
+  )
+{
+  m_fonts_dir = fonts_dir;
+  m_fonts = fonts;
+  m_sample_fonts = 0;
+  m_bitmaps = m_samples = 0;
+  m_render_rate = m_transform_rate = m_save_rate = 0.0;
+  m_memory = m_bytes_per_sample = 0.0;
+  m_memory_limit = 0;
+  m_transform_threads = m_encode_threads = 1;
+  m_batch_size = Constants::BATCH_SIZE;
+  m_compression = Constants::PNG_COMPRESSION;
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method: the sample is rendered once. Transformations are timed
+// with 1, 2, 4 ... threads up to the hardware threads, then saving is timed
+// for every compression level and number of threads, and last for the batch
+// sizes whose projected memory fits the limit.
+// Inputs: generator with every option set and without fonts
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats: the stages of a run are sequential, so each one
+// takes the configuration that maximizes its own rate.
+//
+// -----------------------------------------------------------------------------
+void
+Calibration::run
+  (
+  const MyFreetype &freetype,
+  const size_t memory_limit
+  )
+{
+  m_memory_limit = memory_limit;
+  m_sample_fonts = std::min<unsigned>(Constants::CALIBRATION_FONTS, m_fonts.size());
+  std::vector<unsigned> threads;
+  const unsigned hardware = std::max(std::thread::hardware_concurrency(), 1u);
+  for (unsigned t=1; t < hardware; t*=2)
+    threads.push_back(t);
+  threads.push_back(hardware);
+
+  MyFreetype rendered = freetype;
+  double ticks = static_cast<double>(cv::getTickCount());
+  for (unsigned i=0; i < m_sample_fonts; i++)
+    rendered.generateImagesFromTrueTypeFont((m_fonts_dir + m_fonts[i]).c_str());
+  ticks = static_cast<double>(cv::getTickCount()) - ticks;
+  m_bitmaps = rendered.getMetrics().bitmaps;
+  m_render_rate = m_bitmaps / (ticks / cv::getTickFrequency());
+
+  MyFreetype transformed;
+  for (unsigned i=0; i < threads.size(); i++)
+  {
+    MyFreetype trial = rendered;
+    trial.setThreads(threads[i], 1);
+    ticks = static_cast<double>(cv::getTickCount());
+    trial.transformImages();
+    ticks = static_cast<double>(cv::getTickCount()) - ticks;
+    double rate = trial.getMetrics().samples / (ticks / cv::getTickFrequency());
+    if (rate > m_transform_rate)
+    {
+      m_transform_rate = rate;
+      m_transform_threads = threads[i];
+      transformed = trial;
+    }
+  }
+  m_samples = transformed.getMetrics().samples;
+  m_memory = static_cast<double>(rendered.memoryUsage() + transformed.memoryUsage());
+
+  const int levels[] = {1, 3, 6, 9};
+  for (unsigned l=0; l < sizeof(levels)/sizeof(levels[0]); l++)
+  {
+    for (unsigned i=0; i < threads.size(); i++)
+    {
+      MyFreetype trial = transformed;
+      trial.setThreads(m_transform_threads, threads[i]);
+      trial.setCompression(levels[l]);
+      double rate = this->measureSave(trial);
+      if (rate > m_save_rate)
+      {
+        m_save_rate = rate;
+        m_encode_threads = threads[i];
+        m_compression = levels[l];
+        m_bytes_per_sample = static_cast<double>(trial.getMetrics().bytes) / std::max(m_samples, 1u);
+      }
+    }
+  }
+
+  // Encoded batches are the only memory that depends on the configuration
+  m_save_rate = 0.0;
+  for (unsigned batch_size=Constants::BATCH_SIZE/16; batch_size <= Constants::BATCH_SIZE*4; batch_size*=4)
+  {
+    if ((projectedMemory(batch_size) > m_memory_limit) && (batch_size > Constants::BATCH_SIZE/16))
+      break;
+    MyFreetype trial = transformed;
+    trial.setThreads(m_transform_threads, m_encode_threads);
+    trial.setCompression(m_compression);
+    trial.setBatchSize(batch_size);
+    double rate = this->measureSave(trial);
+    if (rate > m_save_rate)
+    {
+      m_save_rate = rate;
+      m_batch_size = batch_size;
+    }
+  }
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method:
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+void
+Calibration::apply
+  (
+  MyFreetype &freetype
+  ) const
+{
+  freetype.setThreads(m_transform_threads, m_encode_threads);
+  freetype.setBatchSize(m_batch_size);
+  freetype.setCompression(m_compression);
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method: the whole run is projected from the sample fonts, every
+// font is expected to render the same number of images.
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+void
+Calibration::print
+  () const
+{
+  const double scale = static_cast<double>(m_fonts.size()) / std::max(m_sample_fonts, 1u);
+  const double bitmaps = m_bitmaps * scale;
+  const double samples = m_samples * scale;
+  const double seconds = bitmaps/m_render_rate + samples/m_transform_rate + samples/m_save_rate;
+  const double megabyte = 1024.0*1024.0;
+
+  PRINT("Calibrated on " << m_sample_fonts << " of " << m_fonts.size() << " fonts");
+  PRINT("  render: " << m_render_rate << " images/s with 1 thread");
+  PRINT("  transform: " << m_transform_rate << " images/s with " << m_transform_threads << " threads");
+  PRINT("  save: " << m_save_rate << " images/s with " << m_encode_threads << " threads, batches of " << m_batch_size << " and compression " << m_compression);
+  PRINT("Projected " << samples << " samples in " << seconds << " s, " << samples*m_bytes_per_sample/megabyte << " MB on disk and " << projectedMemory(m_batch_size)/megabyte << " MB of peak memory");
+  if (projectedMemory(m_batch_size) > m_memory_limit)
+    ERROR("Warning. The projected memory exceeds the limit of " << m_memory_limit/megabyte << " MB");
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method:
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats: the calibration directory is removed afterwards.
+//
+// -----------------------------------------------------------------------------
+double
+Calibration::measureSave
+  (
+  MyFreetype &trial
+  ) const
+{
+  boost::filesystem::create_directories(Constants::CALIBRATION_DIR);
+  double ticks = static_cast<double>(cv::getTickCount());
+  trial.saveImages(Constants::CALIBRATION_DIR);
+  ticks = static_cast<double>(cv::getTickCount()) - ticks;
+  boost::filesystem::remove_all(Constants::CALIBRATION_DIR);
+  return m_samples / (ticks / cv::getTickFrequency());
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method: rendered and transformed images are held until they are
+// saved, plus a batch of encoded images.
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+double
+Calibration::projectedMemory
+  (
+  const unsigned batch_size
+  ) const
+{
+  const double scale = static_cast<double>(m_fonts.size()) / std::max(m_sample_fonts, 1u);
+  return m_memory*scale + batch_size*m_bytes_per_sample;
+}
+
+} // close namespace urjc
@@ -15,8 +15,33 @@ namespace urjc {
 
 const char *Constants::FONTS_DIR = "../database/fonts/";
 const char *Constants::CHARS_DIR = "../database/chars/";
+const char *Constants::CALIBRATION_DIR = "../database/calibration/";
+const char *Constants::CATALOG_FILE = "../database/fonts.idx";
 const double Constants::ROTATION_ANGLE = 5.0;
 const unsigned Constants::CHAR_SIZE = 20;
+const unsigned Constants::CHAR_DPI = 200;
 const unsigned Constants::NUM_ITERS = 5;
+const unsigned Constants::DEDUP_RETRIES = 3;
+const unsigned Constants::LINE_LENGTH = 30;
+const unsigned Constants::LINE_MARGIN = 2;
+const double Constants::LINE_CONTEXT = 0.25;
+const double Constants::GOLDEN_MARGIN = 0.2;
+const double Constants::BUDGET_FLOOR = 0.05;
+const unsigned Constants::SDF_SCALE = 2;
+const unsigned Constants::SUPERSAMPLE_MAX = 16;
+const unsigned Constants::INK_THRESHOLD = 128;
+const unsigned Constants::BATCH_SIZE = 256;
+const unsigned Constants::CALIBRATION_FONTS = 2;
+const unsigned Constants::MEMORY_LIMIT = 4096;
+const int Constants::PNG_COMPRESSION = 3;
+const unsigned Constants::SHARD_SIZE = 256;
+const unsigned Constants::SHUFFLE_MEMORY = 1024;
+const unsigned Constants::BUDGET_CHUNK = 20000;
+const char *Constants::CHECKPOINT_FILE = "checkpoint.txt";
+const unsigned Constants::NOISE_TILES = 8;
+const unsigned Constants::NOISE_TILE_SIZE = 128;
+const unsigned Constants::NOISE_SEED = 12345;
+const unsigned Constants::JPEG_QUALITY_MIN = 20;
+const unsigned Constants::JPEG_QUALITY_MAX = 90;
 
 }; // close namespace urjc
@@ -0,0 +1,393 @@
+/** ****************************************************************************
+ *  @file    DatasetReader.cpp
+ *  @brief   Prefetching and shuffling reader of generated datasets.
+ *  @author  Roberto Valle Fernandez.
+ *  @date    2012/01
+ *  @copyright All rights reserved.
+ *  Escuela Tecnica Superior de Ingenieria Informatica (Computer Science School)
+ *  Universidad Rey Juan Carlos (Spain)
+ ******************************************************************************/
+
+// ----------------------- INCLUDES --------------------------------------------
+#include <DatasetReader.hpp>
+#include <trace.hpp>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <boost/filesystem.hpp>
+#include <opencv/highgui.h>
+
+namespace urjc {
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method: shards are used when the directory has shard indexes,
+// otherwise every PNG file outside the text lines is an entry.
+// Inputs: output directory of the generator
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats: two batches per thread are kept in flight.
+//
+// -----------------------------------------------------------------------------
+DatasetReader::DatasetReader
+  (
+  const std::string &dataset_dir,
+  const unsigned num_threads,
+  const unsigned batch_size,
+  const unsigned shuffle_size,
+  const uint64_t seed
+  )
+{
+  m_num_threads = std::max(num_threads, 1u);
+  m_batch_size = std::max(batch_size, 1u);
+  m_shuffle_size = shuffle_size;
+  m_seed = seed;
+  m_epoch = 0;
+  m_num_batches = m_next_batch = m_emitted = 0;
+  m_stop = false;
+
+  if (boost::filesystem::exists(boost::filesystem::path(dataset_dir) / "shard-000000.idx"))
+    this->listShards(dataset_dir);
+  else
+    this->listFiles(dataset_dir);
+
+  m_batches.resize(2*m_num_threads);
+  for (unsigned i=0; i < m_batches.size(); i++)
+  {
+    m_batches[i].images.resize(m_batch_size);
+    m_batches[i].labels.resize(m_batch_size);
+  }
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method:
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+DatasetReader::~DatasetReader
+  ()
+{
+  this->stopWorkers();
+  for (unsigned i=0; i < m_shards.size(); i++)
+    close(m_shards[i]);
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method: files are sorted so that every run lists them in the
+// same order, each class directory is a group.
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+void
+DatasetReader::listFiles
+  (
+  const std::string &dataset_dir
+  )
+{
+  namespace fs = boost::filesystem;
+  std::vector<std::string> paths;
+  const fs::path root(dataset_dir);
+  for (fs::recursive_directory_iterator it(root), end; it != end; it++)
+    if (fs::is_regular_file(it->path()) && (it->path().extension().string().compare(".png") == 0))
+      paths.push_back(it->path().string());
+  std::sort(paths.begin(), paths.end());
+
+  std::map<std::string, unsigned> classes;
+  for (unsigned i=0; i < paths.size(); i++)
+  {
+    std::string name = fs::path(paths[i]).parent_path().string().substr(root.string().size());
+    while (!name.empty() && (name[0] == '/'))
+      name.erase(0, 1);
+    if ((name.compare("lines") == 0) || ((name.size() > 6) && (name.compare(name.size()-6, 6, "/lines") == 0)))
+      continue;
+
+    if (classes.find(name) == classes.end())
+    {
+      classes[name] = m_labels.size();
+      m_labels.push_back(name);
+      m_groups.push_back(m_entries.size());
+    }
+    DatasetEntry entry;
+    entry.label = classes[name];
+    entry.path = paths[i];
+    entry.shard = -1;
+    entry.offset = entry.size = 0;
+    m_entries.push_back(entry);
+  }
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method: each index line is 'key offset size label', the class
+// is the directory of the key. Each shard is a group.
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats: text lines, whose label is 'txt', are skipped.
+//
+// -----------------------------------------------------------------------------
+void
+DatasetReader::listShards
+  (
+  const std::string &dataset_dir
+  )
+{
+  std::map<std::string, unsigned> classes;
+  for (unsigned shard=0; ; shard++)
+  {
+    char name[32];
+    sprintf(name, "shard-%06u", shard);
+    std::string base = (boost::filesystem::path(dataset_dir) / name).string();
+    std::ifstream index((base + ".idx").c_str());
+    if (!index.is_open())
+      break;
+    int fd = open((base + ".tar").c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+      ERROR("Error. File " << base << ".tar can't be opened");
+      break;
+    }
+    m_shards.push_back(fd);
+    m_groups.push_back(m_entries.size());
+
+    std::string line;
+    while (std::getline(index, line))
+    {
+      std::stringstream ss(line);
+      std::string key, label;
+      DatasetEntry entry;
+      ss >> key >> entry.offset >> entry.size >> label;
+      if (label.compare("txt") == 0)
+        continue;
+      std::string cls = key.substr(0, key.rfind('/'));
+      if (classes.find(cls) == classes.end())
+      {
+        classes[cls] = m_labels.size();
+        m_labels.push_back(cls);
+      }
+      entry.label = classes[cls];
+      entry.shard = shard;
+      m_entries.push_back(entry);
+    }
+  }
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method: groups are shuffled, then entries go through a buffer
+// of 'shuffle_size' entries and a random one leaves it each time a new one
+// comes in. A zero size keeps the listing order.
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats: the previous epoch is stopped if it didn't end.
+//
+// -----------------------------------------------------------------------------
+void
+DatasetReader::startEpoch
+  ()
+{
+  this->stopWorkers();
+  cv::RNG rng(m_seed + m_epoch++);
+
+  m_order.clear();
+  std::vector<unsigned> groups(m_groups.size());
+  for (unsigned g=0; g < groups.size(); g++)
+    groups[g] = g;
+  if (m_shuffle_size > 0)
+    for (unsigned g=groups.size(); g > 1; g--)
+      std::swap(groups[g-1], groups[rng.uniform(0, static_cast<int>(g))]);
+
+  std::vector<unsigned> buffer;
+  for (unsigned g=0; g < groups.size(); g++)
+  {
+    unsigned first = m_groups[groups[g]];
+    unsigned last = (groups[g]+1 < m_groups.size()) ? m_groups[groups[g]+1] : m_entries.size();
+    for (unsigned i=first; i < last; i++)
+    {
+      if (buffer.size() < m_shuffle_size)
+      {
+        buffer.push_back(i);
+        continue;
+      }
+      if (m_shuffle_size == 0)
+      {
+        m_order.push_back(i);
+        continue;
+      }
+      unsigned slot = rng.uniform(0, static_cast<int>(buffer.size()));
+      m_order.push_back(buffer[slot]);
+      buffer[slot] = i;
+    }
+  }
+  for (unsigned n=buffer.size(); n > 1; n--)
+    std::swap(buffer[n-1], buffer[rng.uniform(0, static_cast<int>(n))]);
+  m_order.insert(m_order.end(), buffer.begin(), buffer.end());
+
+  m_num_batches = (m_order.size() + m_batch_size - 1) / m_batch_size;
+  m_next_batch = m_emitted = 0;
+  m_stop = false;
+  m_ready.clear();
+  m_free.clear();
+  for (unsigned i=0; i < m_batches.size(); i++)
+    m_free.push_back(&m_batches[i]);
+  for (unsigned t=0; t < m_num_threads; t++)
+    m_workers.push_back(std::thread(&DatasetReader::prefetch, this));
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method:
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+const Batch*
+DatasetReader::next
+  ()
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+  if (m_emitted >= m_num_batches)
+    return NULL;
+  m_condition.wait(lock, [this]() { return m_ready.count(m_emitted) > 0; });
+  Batch *batch = m_ready[m_emitted];
+  m_ready.erase(m_emitted++);
+  return batch;
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method:
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+void
+DatasetReader::release
+  (
+  const Batch *batch
+  )
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_free.push_back(const_cast<Batch*>(batch));
+  m_condition.notify_all();
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method:
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats: shards are read with pread, so threads share the
+// same file descriptors.
+//
+// -----------------------------------------------------------------------------
+bool
+DatasetReader::readEntry
+  (
+  const DatasetEntry &entry,
+  std::vector<uchar> &buffer
+  ) const
+{
+  if (entry.shard >= 0)
+  {
+    buffer.resize(entry.size);
+    return pread(m_shards[entry.shard], buffer.data(), entry.size, entry.offset) == static_cast<ssize_t>(entry.size);
+  }
+
+  std::ifstream ifs(entry.path.c_str(), std::ios::binary);
+  if (!ifs.is_open())
+    return false;
+  ifs.seekg(0, std::ios::end);
+  buffer.resize(static_cast<size_t>(ifs.tellg()));
+  ifs.seekg(0, std::ios::beg);
+  ifs.read(reinterpret_cast<char*>(buffer.data()), buffer.size());
+  return ifs.good();
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method: each worker takes the next batch number and a free
+// batch, reads and decodes its images in place and hands it in order.
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats: images that can't be read are left empty.
+//
+// -----------------------------------------------------------------------------
+void
+DatasetReader::prefetch
+  ()
+{
+  std::vector<uchar> buffer;
+  while (true)
+  {
+    unsigned number;
+    Batch *batch;
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_condition.wait(lock, [this]() { return m_stop || (m_next_batch >= m_num_batches) || !m_free.empty(); });
+      if (m_stop || (m_next_batch >= m_num_batches))
+        return;
+      number = m_next_batch++;
+      batch = m_free.back();
+      m_free.pop_back();
+    }
+
+    unsigned first = number*m_batch_size;
+    batch->size = std::min<unsigned>(m_batch_size, m_order.size() - first);
+    for (unsigned k=0; k < batch->size; k++)
+    {
+      const DatasetEntry &entry = m_entries[m_order[first + k]];
+      batch->labels[k] = entry.label;
+      if (this->readEntry(entry, buffer))
+        cv::imdecode(cv::Mat(buffer), CV_LOAD_IMAGE_GRAYSCALE, &batch->images[k]);
+      else
+        batch->images[k].release();
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_ready[number] = batch;
+    m_condition.notify_all();
+  }
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method:
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+void
+DatasetReader::stopWorkers
+  ()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stop = true;
+    m_condition.notify_all();
+  }
+  for (unsigned t=0; t < m_workers.size(); t++)
+    m_workers[t].join();
+  m_workers.clear();
+}
+
+} // close namespace urjc
@@ -0,0 +1,172 @@
+/** ****************************************************************************
+ *  @file    Degradation.cpp
+ *  @brief   Scanner and camera degradations from precomputed banks.
+ *  @author  Roberto Valle Fernandez.
+ *  @date    2012/01
+ *  @copyright All rights reserved.
+ *  Escuela Tecnica Superior de Ingenieria Informatica (Computer Science School)
+ *  Universidad Rey Juan Carlos (Spain)
+ ******************************************************************************/
+
+// ----------------------- INCLUDES --------------------------------------------
+#include <Degradation.hpp>
+#include <Constants.hpp>
+#include <Profiler.hpp>
+#include <cmath>
+#include <opencv/highgui.h>
+
+namespace urjc {
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method: kernels are drawn antialiased in 8 bits and normalized.
+// Motion kernels are lines of several lengths and angles, defocus kernels are
+// disks of several radius.
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats: the banks use a fixed seed, every run shares them
+// and the randomness of each sample comes from the entries it selects. They
+// are only built once.
+//
+// -----------------------------------------------------------------------------
+void
+Degradation::build
+  ()
+{
+  if (!m_psfs.empty())
+    return;
+
+  for (int length=3; length <= 7; length+=2)
+  {
+    for (int angle=0; angle < 180; angle+=30)
+    {
+      cv::Mat kernel = cv::Mat::zeros(length, length, CV_8UC1);
+      double dx = 0.5*(length-1)*cos(angle*CV_PI/180.0);
+      double dy = 0.5*(length-1)*sin(angle*CV_PI/180.0);
+      cv::Point center(length/2, length/2);
+      cv::line(kernel, cv::Point(cvRound(center.x-dx), cvRound(center.y-dy)), cv::Point(cvRound(center.x+dx), cvRound(center.y+dy)), cv::Scalar(255), 1, CV_AA);
+      m_psfs.push_back(kernel);
+    }
+  }
+  for (int radius=1; radius <= 3; radius++)
+  {
+    cv::Mat kernel = cv::Mat::zeros(2*radius+1, 2*radius+1, CV_8UC1);
+    cv::circle(kernel, cv::Point(radius, radius), radius, cv::Scalar(255), -1, CV_AA);
+    m_psfs.push_back(kernel);
+  }
+  for (unsigned i=0; i < m_psfs.size(); i++)
+  {
+    cv::Mat kernel;
+    m_psfs[i].convertTo(kernel, CV_32F);
+    m_psfs[i] = kernel / cv::sum(kernel)[0];
+  }
+
+  cv::RNG rng(Constants::NOISE_SEED);
+  for (unsigned i=0; i < Constants::NOISE_TILES; i++)
+  {
+    cv::Mat tile(Constants::NOISE_TILE_SIZE, Constants::NOISE_TILE_SIZE, CV_32F);
+    rng.fill(tile, cv::RNG::NORMAL, cv::Scalar(0.0), cv::Scalar(1.0));
+    m_tiles.push_back(tile);
+  }
+
+  // Gaussian deviations and Poisson photons per intensity level
+  const float sigmas[] = {2.0f, 4.0f, 8.0f};
+  const float photons[] = {1.0f, 2.0f, 4.0f};
+  for (unsigned i=0; i < 3; i++)
+    m_deviations.push_back(std::vector<float>(256, sigmas[i]));
+  for (unsigned i=0; i < 3; i++)
+  {
+    std::vector<float> deviation(256);
+    for (unsigned value=0; value < 256; value++)
+      deviation[value] = sqrt(value/photons[i]);
+    m_deviations.push_back(deviation);
+  }
+
+  m_params.push_back(CV_IMWRITE_JPEG_QUALITY);
+  m_params.push_back(Constants::JPEG_QUALITY_MAX);
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method: each degradation is applied with a probability of one
+// half, in the order of the acquisition: blur, sensor noise and compression.
+// Inputs: 8 bits gray scale image
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats: JPEG is decoded in place, so 'img' must not share
+// its data with other images.
+//
+// -----------------------------------------------------------------------------
+void
+Degradation::apply
+  (
+  cv::RNG &rng,
+  cv::Mat &img,
+  Augmentation &aug
+  )
+{
+  ProfileScope scope("degradation");
+  if (rng.uniform(0, 2) == 1)
+  {
+    unsigned psf = rng.uniform(0, static_cast<int>(m_psfs.size()));
+    aug.psf = psf+1;
+    cv::Mat output;
+    cv::filter2D(img, output, -1, m_psfs[psf]);
+    img = output;
+  }
+
+  if (rng.uniform(0, 2) == 1)
+  {
+    unsigned noise = rng.uniform(0, static_cast<int>(m_deviations.size()));
+    aug.noise = noise+1;
+    this->addNoise(rng, img, m_deviations[noise]);
+  }
+
+  if (rng.uniform(0, 2) == 1)
+  {
+    int quality = rng.uniform(static_cast<int>(Constants::JPEG_QUALITY_MIN), static_cast<int>(Constants::JPEG_QUALITY_MAX)+1);
+    aug.jpeg = quality;
+    m_params[1] = quality;
+    cv::imencode(".jpg", img, m_buffer, m_params);
+    cv::imdecode(cv::Mat(m_buffer), CV_LOAD_IMAGE_GRAYSCALE, &img);
+  }
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method: the tile is read from a random offset and wraps around,
+// so images bigger than a tile are also covered.
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+void
+Degradation::addNoise
+  (
+  cv::RNG &rng,
+  cv::Mat &img,
+  const std::vector<float> &deviation
+  ) const
+{
+  const cv::Mat &tile = m_tiles[rng.uniform(0, static_cast<int>(m_tiles.size()))];
+  const int size = tile.rows;
+  const int row0 = rng.uniform(0, size);
+  const int col0 = rng.uniform(0, size);
+  for (int row=0; row < img.rows; row++)
+  {
+    uchar *pixels = img.ptr<uchar>(row);
+    const float *noise = tile.ptr<float>((row0 + row) % size);
+    int col_noise = col0;
+    for (int col=0; col < img.cols; col++)
+    {
+      pixels[col] = cv::saturate_cast<uchar>(pixels[col] + noise[col_noise]*deviation[pixels[col]]);
+      if (++col_noise == size)
+        col_noise = 0;
+    }
+  }
+}
+
+} // close namespace urjc
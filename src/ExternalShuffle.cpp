@@ -0,0 +1,164 @@
+/** ****************************************************************************
+ *  @file    ExternalShuffle.cpp
+ *  @brief   Shuffle encoded samples larger than memory through spill files.
+ *  @author  Roberto Valle Fernandez.
+ *  @date    2012/01
+ *  @copyright All rights reserved.
+ *  Escuela Tecnica Superior de Ingenieria Informatica (Computer Science School)
+ *  Universidad Rey Juan Carlos (Spain)
+ ******************************************************************************/
+
+// ----------------------- INCLUDES --------------------------------------------
+#include <ExternalShuffle.hpp>
+#include <utils.hpp>
+#include <trace.hpp>
+#include <cstdio>
+#include <algorithm>
+#include <boost/filesystem.hpp>
+
+namespace urjc {
+
+/**
+ * @brief Sample read back from a bucket.
+ */
+struct SpilledSample
+{
+  std::string key, label;
+  std::vector<uchar> data;
+};
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method:
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+ExternalShuffle::ExternalShuffle
+  (
+  const std::string &spill_dir,
+  const unsigned num_buckets,
+  const uint64_t seed
+  ) : m_rng(sampleSeed(seed, 0xFFFFFFFE, 0))
+{
+  m_spill_dir = spill_dir;
+  m_seed = seed;
+  boost::filesystem::create_directories(m_spill_dir);
+  for (unsigned b=0; b < std::max(num_buckets, 1u); b++)
+    m_buckets.push_back(new std::ofstream(this->bucketName(b).c_str(), std::ios::binary));
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method:
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats: buckets are removed even if they weren't written.
+//
+// -----------------------------------------------------------------------------
+ExternalShuffle::~ExternalShuffle
+  ()
+{
+  for (unsigned b=0; b < m_buckets.size(); b++)
+    delete m_buckets[b];
+  boost::filesystem::remove_all(m_spill_dir);
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method: each record is the key, the label and the data, all of
+// them after their 32 bits length.
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+void
+ExternalShuffle::add
+  (
+  const std::string &key,
+  const std::vector<uchar> &data,
+  const std::string &label
+  )
+{
+  std::ofstream &bucket = *m_buckets[m_rng.uniform(0, static_cast<int>(m_buckets.size()))];
+  writeString(bucket, key);
+  writeString(bucket, label);
+  writeValue<uint32_t>(bucket, data.size());
+  bucket.write(reinterpret_cast<const char*>(data.data()), data.size());
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method: Fisher-Yates shuffle of each bucket with its own seed.
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats: each bucket is removed once it is written.
+//
+// -----------------------------------------------------------------------------
+void
+ExternalShuffle::write
+  (
+  ShardWriter &shards
+  )
+{
+  for (unsigned b=0; b < m_buckets.size(); b++)
+    m_buckets[b]->close();
+
+  for (unsigned b=0; b < m_buckets.size(); b++)
+  {
+    std::vector<SpilledSample> samples;
+    std::ifstream ifs(this->bucketName(b).c_str(), std::ios::binary);
+    while (ifs.peek() != EOF)
+    {
+      SpilledSample sample;
+      uint32_t size = 0;
+      readString(ifs, sample.key);
+      readString(ifs, sample.label);
+      readValue<uint32_t>(ifs, size);
+      sample.data.resize(size);
+      ifs.read(reinterpret_cast<char*>(sample.data.data()), size);
+      if (!ifs)
+      {
+        ERROR("Error. Bucket " << this->bucketName(b) << " is truncated");
+        break;
+      }
+      samples.push_back(sample);
+    }
+    ifs.close();
+
+    cv::RNG rng(sampleSeed(m_seed, 0xFFFFFFFE, b+1));
+    for (unsigned n=samples.size(); n > 1; n--)
+      std::swap(samples[n-1], samples[rng.uniform(0, static_cast<int>(n))]);
+    for (unsigned n=0; n < samples.size(); n++)
+      shards.write(samples[n].key, samples[n].data, samples[n].label);
+    boost::filesystem::remove(this->bucketName(b));
+  }
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method:
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+std::string
+ExternalShuffle::bucketName
+  (
+  const unsigned bucket
+  ) const
+{
+  char name[32];
+  sprintf(name, "bucket-%06u.bin", bucket);
+  return (boost::filesystem::path(m_spill_dir) / name).string();
+}
+
+} // close namespace urjc
@@ -0,0 +1,314 @@
+/** ****************************************************************************
+ *  @file    FontCatalog.cpp
+ *  @brief   Index of the fonts directory to select fonts without opening them.
+ *  @author  Roberto Valle Fernandez.
+ *  @date    2012/01
+ *  @copyright All rights reserved.
+ *  Escuela Tecnica Superior de Ingenieria Informatica (Computer Science School)
+ *  Universidad Rey Juan Carlos (Spain)
+ ******************************************************************************/
+
+// ----------------------- INCLUDES --------------------------------------------
+#include <FontCatalog.hpp>
+#include <utils.hpp>
+#include <trace.hpp>
+
+#include <map>
+#include <set>
+#include <fstream>
+#include <algorithm>
+#include <cstring>
+#include <boost/filesystem.hpp>
+#include <freetype2/ft2build.h>
+#include FT_FREETYPE_H
+#include FT_XFREE86_H
+
+namespace urjc {
+
+const char CATALOG_MAGIC[4] = { 'G', 'D', 'B', 'C' };
+const uint32_t CATALOG_VERSION = 1;
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method:
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats: files of another version are discarded.
+//
+// -----------------------------------------------------------------------------
+void
+FontCatalog::load
+  (
+  const std::string &filename
+  )
+{
+  m_entries.clear();
+  m_modified = true;
+  std::ifstream ifs(filename.c_str(), std::ios::binary);
+  if (!ifs.is_open())
+    return;
+
+  char magic[4];
+  uint32_t version = 0, num_entries = 0;
+  ifs.read(magic, sizeof(magic));
+  readValue(ifs, version);
+  readValue(ifs, num_entries);
+  if ((memcmp(magic, CATALOG_MAGIC, sizeof(magic)) != 0) || (version != CATALOG_VERSION))
+    return;
+
+  m_entries.resize(num_entries);
+  for (unsigned i=0; i < num_entries; i++)
+  {
+    FontEntry &entry = m_entries[i];
+    readString(ifs, entry.filename);
+    readString(ifs, entry.format);
+    readString(ifs, entry.family);
+    readString(ifs, entry.style);
+    readValue(ifs, entry.file_size);
+    readValue(ifs, entry.hash);
+    readValue(ifs, entry.modified);
+    readValue(ifs, entry.coverage);
+    readValue(ifs, entry.complexity);
+  }
+  if (!ifs)
+  {
+    ERROR("Error. Catalog " << filename << " is truncated");
+    m_entries.clear();
+    return;
+  }
+  m_modified = false;
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method:
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+void
+FontCatalog::save
+  (
+  const std::string &filename
+  )
+{
+  if (!m_modified)
+    return;
+
+  std::ofstream ofs(filename.c_str(), std::ios::binary);
+  if (!ofs.is_open())
+  {
+    ERROR("Error. Catalog " << filename << " can't be written");
+    return;
+  }
+  ofs.write(CATALOG_MAGIC, sizeof(CATALOG_MAGIC));
+  writeValue(ofs, CATALOG_VERSION);
+  writeValue(ofs, static_cast<uint32_t>(m_entries.size()));
+  for (unsigned i=0; i < m_entries.size(); i++)
+  {
+    const FontEntry &entry = m_entries[i];
+    writeString(ofs, entry.filename);
+    writeString(ofs, entry.format);
+    writeString(ofs, entry.family);
+    writeString(ofs, entry.style);
+    writeValue(ofs, entry.file_size);
+    writeValue(ofs, entry.hash);
+    writeValue(ofs, entry.modified);
+    writeValue(ofs, entry.coverage);
+    writeValue(ofs, entry.complexity);
+  }
+  m_modified = false;
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method: only the size and modification time of each file are
+// read to know if its entry is still valid.
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+void
+FontCatalog::refresh
+  (
+  const std::string &fonts_dir
+  )
+{
+  std::map<std::string, FontEntry> previous;
+  for (unsigned i=0; i < m_entries.size(); i++)
+    previous[m_entries[i].filename] = m_entries[i];
+
+  std::vector<FontEntry> entries;
+  boost::filesystem::directory_iterator it_end;
+  for (boost::filesystem::directory_iterator it(fonts_dir); it != it_end; it++)
+  {
+    if (!boost::filesystem::is_regular_file(it->path()))
+      continue;
+
+    FontEntry entry;
+    entry.filename = it->path().filename().string();
+    entry.file_size = boost::filesystem::file_size(it->path());
+    entry.modified = boost::filesystem::last_write_time(it->path());
+
+    std::map<std::string, FontEntry>::const_iterator found = previous.find(entry.filename);
+    if ((found != previous.end()) && (found->second.file_size == entry.file_size) && (found->second.modified == entry.modified))
+    {
+      entries.push_back(found->second);
+      continue;
+    }
+
+    TRACE("Catalog font: " << entry.filename);
+    this->analyzeFont(it->path().string(), entry);
+    entries.push_back(entry);
+    m_modified = true;
+  }
+
+  if (entries.size() != m_entries.size())
+    m_modified = true;
+  m_entries = entries;
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method:
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+bool
+compareFontEntries
+  (
+  const FontEntry *a,
+  const FontEntry *b
+  )
+{
+  if (a->family != b->family)
+    return a->family < b->family;
+  if (a->style != b->style)
+    return a->style < b->style;
+  return a->filename < b->filename;
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method:
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+void
+FontCatalog::select
+  (
+  const std::vector<unsigned> &characters,
+  std::vector<std::string> &filenames
+  ) const
+{
+  std::vector<const FontEntry*> selected;
+  for (unsigned i=0; i < m_entries.size(); i++)
+  {
+    const FontEntry &entry = m_entries[i];
+    if (entry.format.compare("TrueType") != 0)
+    {
+      TRACE("Skip font " << entry.filename << ": format " << entry.format);
+      continue;
+    }
+
+    bool covered = true;
+    for (unsigned j=0; j < characters.size(); j++)
+      if ((characters[j] >= 256) || !(entry.coverage[characters[j]/64] & (1ULL << (characters[j]%64))))
+        covered = false;
+    if (!covered)
+    {
+      TRACE("Skip font " << entry.filename << ": missing glyphs");
+      continue;
+    }
+    selected.push_back(&entry);
+  }
+  std::sort(selected.begin(), selected.end(), compareFontEntries);
+
+  std::set<uint64_t> hashes;
+  filenames.clear();
+  for (unsigned i=0; i < selected.size(); i++)
+  {
+    if (!hashes.insert(selected[i]->hash).second)
+    {
+      TRACE("Skip font " << selected[i]->filename << ": repeated content");
+      continue;
+    }
+    filenames.push_back(selected[i]->filename);
+  }
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method: FNV-1a hash of the file contents and outline of the
+// first 256 glyphs.
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats: files that Freetype can't open get an 'unknown'
+// format.
+//
+// -----------------------------------------------------------------------------
+bool
+FontCatalog::analyzeFont
+  (
+  const std::string &path,
+  FontEntry &entry
+  )
+{
+  entry.format = "unknown";
+  entry.hash = 0xcbf29ce484222325ULL;
+  memset(entry.coverage, 0, sizeof(entry.coverage));
+  entry.complexity = 0;
+
+  std::ifstream ifs(path.c_str(), std::ios::binary);
+  if (!ifs.is_open())
+    return false;
+  std::vector<unsigned char> buffer(entry.file_size);
+  if (!buffer.empty())
+    ifs.read(reinterpret_cast<char*>(&buffer[0]), buffer.size());
+  for (unsigned i=0; i < buffer.size(); i++)
+    entry.hash = (entry.hash ^ buffer[i]) * 0x100000001b3ULL;
+
+  FT_Library library;
+  FT_Init_FreeType(&library);
+  FT_Face face;
+  if (buffer.empty() || FT_New_Memory_Face(library, &buffer[0], buffer.size(), 0, &face))
+  {
+    FT_Done_FreeType(library);
+    return false;
+  }
+
+  entry.format = FT_Get_X11_Font_Format(face);
+  entry.family = face->family_name ? face->family_name : "";
+  entry.style = face->style_name ? face->style_name : "";
+
+  unsigned num_covered = 0, num_points = 0;
+  for (FT_Long idx=0; (idx < face->num_glyphs) && (idx < 256); idx++)
+  {
+    if (FT_Load_Glyph(face, idx, FT_LOAD_NO_SCALE))
+      continue;
+    if ((face->glyph->format != FT_GLYPH_FORMAT_OUTLINE) || (face->glyph->outline.n_contours <= 0))
+      continue;
+    entry.coverage[idx/64] |= (1ULL << (idx%64));
+    num_points += face->glyph->outline.n_points;
+    num_covered++;
+  }
+  entry.complexity = (num_covered > 0) ? num_points/num_covered : 0;
+
+  FT_Done_Face(face);
+  FT_Done_FreeType(library);
+  return true;
+}
+
+} // close namespace urjc
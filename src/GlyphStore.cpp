@@ -0,0 +1,210 @@
+/** ****************************************************************************
+ *  @file    GlyphStore.cpp
+ *  @brief   Compact storage of the base glyph bitmaps.
+ *  @author  Roberto Valle Fernandez.
+ *  @date    2012/01
+ *  @copyright All rights reserved.
+ *  Escuela Tecnica Superior de Ingenieria Informatica (Computer Science School)
+ *  Universidad Rey Juan Carlos (Spain)
+ ******************************************************************************/
+
+// ----------------------- INCLUDES --------------------------------------------
+#include <GlyphStore.hpp>
+#include <trace.hpp>
+#include <algorithm>
+
+namespace urjc {
+
+// Longest run or literal sequence described by a control byte
+const unsigned MAX_RUN = 128;
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method:
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+void
+GlyphStore::setBits
+  (
+  const unsigned bits
+  )
+{
+  if ((bits != 8) && (bits != 4))
+  {
+    ERROR("Error. Glyphs are stored with 8 or 4 bits per pixel, not " << bits);
+    return;
+  }
+  m_bits = bits;
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method: the image is cropped to the bounding box of its non
+// zero pixels and scanned row after row. Control bytes below 'MAX_RUN' are
+// followed by one value repeated 'control+1' times, the others by
+// 'control-MAX_RUN+1' literal values (PackBits).
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats: 4 bits literals are packed high nibble first.
+//
+// -----------------------------------------------------------------------------
+unsigned
+GlyphStore::add
+  (
+  const cv::Mat &image
+  )
+{
+  GlyphTile tile;
+  tile.offset = m_data.size();
+  tile.rows = image.rows;
+  tile.cols = image.cols;
+
+  int top = image.rows, bottom = -1, left = image.cols, right = -1;
+  for (int row=0; row < image.rows; row++)
+  {
+    const uchar *ptr = image.ptr<uchar>(row);
+    for (int col=0; col < image.cols; col++)
+    {
+      if (ptr[col] == 0)
+        continue;
+      top = std::min(top, row);
+      bottom = row;
+      left = std::min(left, col);
+      right = std::max(right, col);
+    }
+  }
+  tile.crop = (bottom < 0) ? cv::Rect() : cv::Rect(left, top, right-left+1, bottom-top+1);
+
+  std::vector<uchar> values;
+  values.reserve(tile.crop.area());
+  for (int row=tile.crop.y; row < tile.crop.y+tile.crop.height; row++)
+  {
+    const uchar *ptr = image.ptr<uchar>(row);
+    for (int col=tile.crop.x; col < tile.crop.x+tile.crop.width; col++)
+      values.push_back((m_bits == 8) ? ptr[col] : (ptr[col]*15 + 127) / 255);
+  }
+
+  unsigned i = 0;
+  while (i < values.size())
+  {
+    unsigned run = 1;
+    while ((i+run < values.size()) && (run < MAX_RUN) && (values[i+run] == values[i]))
+      run++;
+    if (run >= 3)
+    {
+      m_data.push_back(run-1);
+      m_data.push_back(values[i]);
+      i += run;
+      continue;
+    }
+
+    // Literals up to the next run of three equal values
+    unsigned end = i;
+    while ((end < values.size()) && (end-i < MAX_RUN))
+    {
+      if ((end+2 < values.size()) && (values[end] == values[end+1]) && (values[end] == values[end+2]))
+        break;
+      end++;
+    }
+    m_data.push_back(MAX_RUN + end-i-1);
+    for (unsigned j=i; j < end; j += (m_bits == 8) ? 1 : 2)
+    {
+      if (m_bits == 8)
+        m_data.push_back(values[j]);
+      else
+        m_data.push_back((values[j] << 4) | ((j+1 < end) ? values[j+1] : 0));
+    }
+    i = end;
+  }
+
+  m_tiles.push_back(tile);
+  return m_tiles.size()-1;
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method:
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+void
+GlyphStore::decode
+  (
+  const unsigned id,
+  cv::Mat &image
+  ) const
+{
+  const GlyphTile &tile = m_tiles[id];
+  image.create(tile.rows, tile.cols, CV_8UC1);
+  image.setTo(cv::Scalar::all(0));
+  if (tile.crop.area() == 0)
+    return;
+
+  const uchar *data = &m_data[0] + tile.offset;
+  const unsigned total = tile.crop.area();
+  const int scale = (m_bits == 8) ? 1 : 17;
+  unsigned i = 0;
+  while (i < total)
+  {
+    const unsigned control = *data++;
+    const unsigned count = (control < MAX_RUN) ? control+1 : control-MAX_RUN+1;
+    for (unsigned j=0; j < count; j++, i++)
+    {
+      uchar value;
+      if (control < MAX_RUN)
+        value = data[0];
+      else if (m_bits == 8)
+        value = data[j];
+      else
+        value = (j % 2 == 0) ? (data[j/2] >> 4) : (data[j/2] & 0x0F);
+      image.at<uchar>(tile.crop.y + i/tile.crop.width, tile.crop.x + i%tile.crop.width) = value*scale;
+    }
+    if (control < MAX_RUN)
+      data++;
+    else
+      data += (m_bits == 8) ? count : (count+1)/2;
+  }
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method:
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+void
+GlyphStore::clear
+  ()
+{
+  std::vector<uchar>().swap(m_data);
+  std::vector<GlyphTile>().swap(m_tiles);
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method:
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+size_t
+GlyphStore::bytes
+  () const
+{
+  return m_data.capacity() + m_tiles.capacity()*sizeof(GlyphTile);
+}
+
+} // close namespace urjc
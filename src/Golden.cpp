@@ -0,0 +1,206 @@
+/** ****************************************************************************
+ *  @file    Golden.cpp
+ *  @brief   Compare generated images and throughput against a reference run.
+ *  @author  Roberto Valle Fernandez.
+ *  @date    2012/01
+ *  @copyright All rights reserved.
+ *  Escuela Tecnica Superior de Ingenieria Informatica (Computer Science School)
+ *  Universidad Rey Juan Carlos (Spain)
+ ******************************************************************************/
+
+// ----------------------- INCLUDES --------------------------------------------
+#include <Golden.hpp>
+#include <trace.hpp>
+
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+
+namespace urjc {
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method: FNV-1a hash of the size and pixels of every image, in
+// order.
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+void
+Golden::addChecksums
+  (
+  const std::string &stage,
+  const std::vector< std::vector<cv::Mat> > &images
+  )
+{
+  for (unsigned i=0; i < images.size(); i++)
+  {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (unsigned j=0; j < images[i].size(); j++)
+    {
+      const cv::Mat &img = images[i][j];
+      int dims[2] = { img.rows, img.cols };
+      const uchar *bytes = reinterpret_cast<const uchar*>(dims);
+      for (unsigned k=0; k < sizeof(dims); k++)
+        hash = (hash ^ bytes[k]) * 0x100000001b3ULL;
+      for (int row=0; row < img.rows; row++)
+      {
+        const uchar *pixels = img.ptr<uchar>(row);
+        for (int col=0; col < img.cols; col++)
+          hash = (hash ^ pixels[col]) * 0x100000001b3ULL;
+      }
+    }
+    m_checksums[stage + " " + std::to_string(i)] = hash;
+  }
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method:
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+void
+Golden::addRate
+  (
+  const std::string &stage,
+  const double rate
+  )
+{
+  m_rates[stage] = rate;
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method: a 'seed <value>' line, a 'checksum <stage> <index>
+// <hash>' line per list of images and a 'rate <stage> <images/s>' line per
+// stage.
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+bool
+Golden::load
+  (
+  const std::string &filename
+  )
+{
+  std::ifstream ifs(filename.c_str());
+  if (!ifs.is_open())
+  {
+    ERROR("Error. File " << filename << " can't be opened");
+    return false;
+  }
+
+  std::string line;
+  while (std::getline(ifs, line))
+  {
+    std::stringstream ss(line);
+    std::string type, stage, index;
+    ss >> type;
+    if (type.compare("seed")==0)
+      ss >> m_seed;
+    else if (type.compare("checksum")==0)
+    {
+      uint64_t hash;
+      ss >> stage >> index >> std::hex >> hash;
+      m_checksums[stage + " " + index] = hash;
+    }
+    else if (type.compare("rate")==0)
+    {
+      double rate;
+      ss >> stage >> rate;
+      m_rates[stage] = rate;
+    }
+  }
+  return true;
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method:
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+bool
+Golden::save
+  (
+  const std::string &filename
+  ) const
+{
+  std::ofstream ofs(filename.c_str());
+  if (!ofs.is_open())
+  {
+    ERROR("Error. File " << filename << " can't be opened");
+    return false;
+  }
+
+  ofs << "seed " << m_seed << "\n";
+  std::map<std::string, uint64_t>::const_iterator it;
+  for (it = m_checksums.begin(); it != m_checksums.end(); it++)
+    ofs << "checksum " << it->first << " " << std::hex << std::setw(16) << std::setfill('0') << it->second << std::dec << "\n";
+  std::map<std::string, double>::const_iterator jt;
+  for (jt = m_rates.begin(); jt != m_rates.end(); jt++)
+    ofs << "rate " << jt->first << " " << jt->second << "\n";
+  return true;
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method:
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats: rates are only comparable on the same machine.
+//
+// -----------------------------------------------------------------------------
+bool
+Golden::compare
+  (
+  const Golden &reference,
+  const double margin
+  ) const
+{
+  bool equal = true;
+  std::map<std::string, uint64_t>::const_iterator it, found;
+  for (it = reference.m_checksums.begin(); it != reference.m_checksums.end(); it++)
+  {
+    found = m_checksums.find(it->first);
+    if ((found == m_checksums.end()) || (found->second != it->second))
+    {
+      ERROR("Error. Images of " << it->first << " differ from the reference");
+      equal = false;
+    }
+  }
+  if (m_checksums.size() != reference.m_checksums.size())
+  {
+    ERROR("Error. " << m_checksums.size() << " lists of images instead of " << reference.m_checksums.size());
+    equal = false;
+  }
+
+  std::map<std::string, double>::const_iterator jt, kt;
+  for (jt = reference.m_rates.begin(); jt != reference.m_rates.end(); jt++)
+  {
+    kt = m_rates.find(jt->first);
+    double rate = (kt == m_rates.end()) ? 0.0 : kt->second;
+    PRINT("Stage " << jt->first << ": " << rate << " images/s (reference " << jt->second << ")");
+    if (rate < jt->second*(1.0-margin))
+    {
+      ERROR("Error. Stage " << jt->first << " is slower than the reference");
+      equal = false;
+    }
+  }
+  return equal;
+}
+
+} // close namespace urjc
@@ -0,0 +1,155 @@
+/** ****************************************************************************
+ *  @file    HashIndex.cpp
+ *  @brief   Perceptual hashing to find near-duplicated images.
+ *  @author  Roberto Valle Fernandez.
+ *  @date    2012/01
+ *  @copyright All rights reserved.
+ *  Escuela Tecnica Superior de Ingenieria Informatica (Computer Science School)
+ *  Universidad Rey Juan Carlos (Spain)
+ ******************************************************************************/
+
+// ----------------------- INCLUDES --------------------------------------------
+#include <HashIndex.hpp>
+#include <bitset>
+#include <algorithm>
+
+namespace urjc {
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method: average hash, the image is reduced to 8x8 pixels by area
+// interpolation and each bit is set when its pixel is brighter than the mean.
+// Inputs: 8 bits gray scale image
+// Outputs: 64 bits hash
+// Dependencies:
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+uint64_t
+perceptualHash
+  (
+  const cv::Mat &img
+  )
+{
+  cv::Mat tile;
+  cv::resize(img, tile, cv::Size(8,8), 0, 0, cv::INTER_AREA);
+
+  unsigned sum = 0;
+  for (int row=0; row < tile.rows; row++)
+    for (int col=0; col < tile.cols; col++)
+      sum += tile.at<uchar>(row, col);
+
+  uint64_t hash = 0;
+  for (int row=0; row < tile.rows; row++)
+    for (int col=0; col < tile.cols; col++)
+      if (static_cast<unsigned>(tile.at<uchar>(row, col))*64 > sum)
+        hash |= (1ULL << (row*8 + col));
+
+  return hash;
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method:
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats: distances bigger than 63 are clamped.
+//
+// -----------------------------------------------------------------------------
+HashIndex::HashIndex
+  (
+  const unsigned max_distance
+  )
+{
+  m_max_distance = std::min(max_distance, 63u);
+
+  // Split 64 bits into 'max_distance+1' chunks of similar width
+  const unsigned num_chunks = m_max_distance + 1;
+  unsigned offset = 0;
+  for (unsigned i=0; i < num_chunks; i++)
+  {
+    unsigned width = 64/num_chunks + ((i < 64%num_chunks) ? 1 : 0);
+    m_offsets.push_back(offset);
+    m_widths.push_back(width);
+    offset += width;
+  }
+  m_tables.resize(num_chunks);
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method: only hashes that share at least one chunk with the
+// query are compared using the Hamming distance.
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+bool
+HashIndex::contains
+  (
+  const uint64_t hash
+  ) const
+{
+  for (unsigned i=0; i < m_tables.size(); i++)
+  {
+    std::unordered_map< uint64_t, std::vector<uint32_t> >::const_iterator it;
+    it = m_tables[i].find(chunk(hash, i));
+    if (it == m_tables[i].end())
+      continue;
+
+    const std::vector<uint32_t> &candidates = it->second;
+    for (unsigned j=0; j < candidates.size(); j++)
+    {
+      std::bitset<64> diff(hash ^ m_hashes[candidates[j]]);
+      if (diff.count() <= m_max_distance)
+        return true;
+    }
+  }
+  return false;
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method:
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+void
+HashIndex::insert
+  (
+  const uint64_t hash
+  )
+{
+  uint32_t id = static_cast<uint32_t>(m_hashes.size());
+  m_hashes.push_back(hash);
+  for (unsigned i=0; i < m_tables.size(); i++)
+    m_tables[i][chunk(hash, i)].push_back(id);
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method:
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+uint64_t
+HashIndex::chunk
+  (
+  const uint64_t hash,
+  const unsigned idx
+  ) const
+{
+  uint64_t mask = (m_widths[idx] == 64) ? ~0ULL : ((1ULL << m_widths[idx]) - 1);
+  return (hash >> m_offsets[idx]) & mask;
+}
+
+} // close namespace urjc
@@ -13,8 +13,20 @@
 #include <Constants.hpp>
 #include <utils.hpp>
 #include <operations.hpp>
+#include <HashIndex.hpp>
+#include <ShardWriter.hpp>
+#include <ExternalShuffle.hpp>
+#include <Provenance.hpp>
+#include <Statistics.hpp>
+#include <Profiler.hpp>
+#include <Tracer.hpp>
+#include <trace.hpp>
 
 #include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <thread>
+#include <atomic>
 #include <boost/filesystem.hpp>
 #include <opencv/highgui.h>
 
@@ -29,15 +41,896 @@ namespace urjc {
 // Restrictions and Caveats:
 //
 // -----------------------------------------------------------------------------
+MyFreetype::MyFreetype
+  ()
+{
+  m_sizes.push_back(CharSize(Constants::CHAR_SIZE, Constants::CHAR_DPI));
+  m_max_distance = -1;
+  m_shard_size = 0;
+  m_shuffle_size = 0;
+  m_transform_threads = std::max(std::thread::hardware_concurrency(), 1u);
+  m_encode_threads = m_transform_threads;
+  m_batch_size = Constants::BATCH_SIZE;
+  m_compression = Constants::PNG_COMPRESSION;
+  m_seed = time(NULL);
+  m_char_map = false;
+  m_num_lines = 0;
+  m_degrade = false;
+  m_sdf = false;
+  m_supersample = 0;
+  m_compact = false;
+  m_numa = false;
+  m_line_length = Constants::LINE_LENGTH;
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method:
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+void
+MyFreetype::setCharacters
+  (
+  std::vector<unsigned> &characters
+  )
+{
+  // Initialize members
+  m_characters = characters;
+  m_images.resize(m_sizes.size()*m_characters.size());
+  m_infos.resize(m_images.size());
+  m_sdfs.resize(m_images.size());
+  m_masters.resize(m_images.size());
+  m_tiles.resize(m_images.size());
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method:
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+void
+MyFreetype::setCharacterSizes
+  (
+  std::vector<CharSize> &sizes
+  )
+{
+  m_sizes = sizes;
+  m_images.resize(m_sizes.size()*m_characters.size());
+  m_infos.resize(m_images.size());
+  m_sdfs.resize(m_images.size());
+  m_masters.resize(m_images.size());
+  m_tiles.resize(m_images.size());
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method:
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+void
+MyFreetype::setDeduplication
+  (
+  const int max_distance
+  )
+{
+  m_max_distance = max_distance;
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method:
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+void
+MyFreetype::setBudget
+  (
+  const Budget &budget
+  )
+{
+  m_budget = budget;
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method:
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+void
+MyFreetype::setCharacterMap
+  (
+  const bool char_map
+  )
+{
+  m_char_map = char_map;
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method:
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+void
+MyFreetype::setDistanceFields
+  (
+  const bool sdf
+  )
+{
+  m_sdf = sdf;
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method:
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats: only valid before rendering any font.
+//
+// -----------------------------------------------------------------------------
+void
+MyFreetype::setSupersampling
+  (
+  const unsigned factor
+  )
+{
+  if (factor > Constants::SUPERSAMPLE_MAX)
+  {
+    ERROR("Error. Supersampling factor " << factor << " above " << Constants::SUPERSAMPLE_MAX);
+    return;
+  }
+  m_supersample = (factor > 1) ? factor : 0;
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method:
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats: only valid before rendering any font.
+//
+// -----------------------------------------------------------------------------
+void
+MyFreetype::setNumaAffinity
+  (
+  const bool numa
+  )
+{
+  m_numa = numa;
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method:
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats: only valid before rendering any font.
+//
+// -----------------------------------------------------------------------------
+void
+MyFreetype::setCompactGlyphs
+  (
+  const unsigned bits
+  )
+{
+  m_compact = (bits > 0);
+  if (m_compact)
+    m_store.setBits(bits);
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method:
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats: the degradation banks are only built when they
+// are used.
+//
+// -----------------------------------------------------------------------------
+void
+MyFreetype::setDegradation
+  (
+  const bool degrade
+  )
+{
+  m_degrade = degrade;
+  if (m_degrade)
+    m_degradation.build();
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method:
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+void
+MyFreetype::setThreads
+  (
+  const unsigned transform_threads,
+  const unsigned encode_threads
+  )
+{
+  m_transform_threads = std::max(transform_threads, 1u);
+  m_encode_threads = std::max(encode_threads, 1u);
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method:
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+void
+MyFreetype::setBatchSize
+  (
+  const unsigned batch_size
+  )
+{
+  m_batch_size = std::max(batch_size, 1u);
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method:
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+void
+MyFreetype::setCompression
+  (
+  const int compression
+  )
+{
+  m_compression = compression;
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method:
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+void
+MyFreetype::setOutputShuffle
+  (
+  const size_t max_bytes
+  )
+{
+  m_shuffle_size = max_bytes;
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method:
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+void
+MyFreetype::setOutputShards
+  (
+  const size_t max_bytes
+  )
+{
+  m_shard_size = max_bytes;
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method:
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+void
+MyFreetype::setTextLines
+  (
+  const unsigned num_lines,
+  const unsigned length
+  )
+{
+  m_num_lines = num_lines;
+  m_line_length = length;
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method:
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+void
+MyFreetype::setSeed
+  (
+  const uint64_t seed
+  )
+{
+  m_seed = seed;
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method:
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+void
+MyFreetype::generateImagesFromTrueTypeFont
+  (
+  const char *input_dir
+  )
+{
+  TRACE_STAGE("font", m_fonts.size());
+
+  // Initialize Freetype library
+  FT_Library library;
+  FT_Init_FreeType(&library);
+
+  // Generate a set of character images using a True Type font directory
+  std::ifstream ttf_file;
+  ttf_file.open(input_dir, std::ios::binary);
+  if (ttf_file.is_open())
+  {
+    // Get length of file
+    ttf_file.seekg(0, std::ios::end);
+    std::fstream::pos_type ttf_size = ttf_file.tellg();
+    ttf_file.seekg (0, std::ios::beg);
+    // Allocate memory
+    unsigned char *buffer = new unsigned char[ttf_size];
+    // Read data as a block
+    ttf_file.read((char*)buffer, ttf_size);
+    ttf_file.close();
+
+    // Create a font face object
+    FT_Face face;
+    FT_New_Memory_Face(library, buffer, ttf_size, 0, &face);
+    m_fonts.push_back(boost::filesystem::path(input_dir).filename().string());
+    m_metrics.faces++;
+
+    // Glyph of each character, through the character map of the font if
+    // asked to
+    m_glyphs.assign(m_characters.begin(), m_characters.end());
+    for (unsigned idx=0; m_char_map && (idx < m_characters.size()); idx++)
+    {
+      std::string character = asciiCode2String(m_characters[idx]);
+      m_glyphs[idx] = FT_Get_Char_Index(face, utf8CodePoint(character));
+      if (m_glyphs[idx] == 0)
+        ERROR("Error. Font " << m_fonts.back() << " has no glyph for " << character);
+    }
+
+    // Dump out each Glyph to a Bitmap
+    for (int idx=0; idx < m_characters.size(); idx++)
+      this->writeGlyphAsBitmap(idx, face);
+
+    if (m_num_lines > 0)
+      this->writeTextLines(library, face);
+
+    // Now that we are done it is safe to delete the memory
+    delete [] buffer;
+
+    FT_Done_Face(face);
+    FT_Done_FreeType(library);
+  }
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method:
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+void
+MyFreetype::transformImages
+  ()
+{
+  std::vector< std::vector<unsigned> > repeats;
+  this->sampleBudget(repeats);
+  std::vector< std::vector<unsigned> > first(repeats.size());
+  for (unsigned i=0; i < repeats.size(); i++)
+    first[i].assign(repeats[i].size(), 0);
+  this->transformRepeats(first, repeats);
+
+  // Every rendered image has been replaced by its transformations
+  m_store.clear();
+  for (unsigned i=0; i < m_tiles.size(); i++)
+    m_tiles[i].clear();
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method:
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+void
+MyFreetype::transformRepeats
+  (
+  const std::vector< std::vector<unsigned> > &first,
+  const std::vector< std::vector<unsigned> > &last
+  )
+{
+  TRACE_STAGE("transform");
+
+  // Classes are independent, each worker takes the next one with its own
+  // accumulators and degradation buffers. Pinned workers take the classes of
+  // their node and only steal from other nodes once theirs are done
+  const unsigned num_threads = m_transform_threads;
+  const unsigned num_nodes = m_numa ? m_topology.size() : 1;
+  const unsigned num_classes = m_images.size();
+  std::vector<Statistics> statistics(num_threads, Statistics(num_classes));
+  std::vector<Metrics> metrics(num_threads);
+  std::vector<Degradation> degradations(num_threads, m_degradation);
+  std::vector<double> seconds(num_threads, 0.0);
+  std::vector<unsigned> stolen(num_threads, 0);
+  std::vector< std::atomic<unsigned> > next(num_nodes);
+  for (unsigned n=0; n < num_nodes; n++)
+    next[n] = n*num_classes/num_nodes;
+  m_class_nodes.assign(num_classes, 0);
+
+  // Each node decodes its glyphs from a copy allocated by one of its threads
+  std::vector<GlyphStore> stores((m_numa && m_compact) ? num_nodes : 0);
+  std::vector<std::thread> workers;
+  for (unsigned n=0; n < stores.size(); n++)
+  {
+    workers.push_back(std::thread([&, n]()
+    {
+      Topology::pinThread(m_topology.cpus(n));
+      stores[n] = m_store;
+    }));
+  }
+  for (unsigned n=0; n < workers.size(); n++)
+    workers[n].join();
+  workers.clear();
+
+  for (unsigned t=0; t < num_threads; t++)
+  {
+    workers.push_back(std::thread([&, t]()
+    {
+      setProfileThread(t+1);
+      const unsigned node = m_numa ? m_topology.workerNode(t) : 0;
+      if (m_numa)
+        Topology::pinThread(std::vector<unsigned>(1, m_topology.workerCpu(t)));
+      const GlyphStore &store = stores.empty() ? m_store : stores[node];
+      double ticks = static_cast<double>(cv::getTickCount());
+      for (unsigned n=0; n < num_nodes; n++)
+      {
+        const unsigned owner = (node + n) % num_nodes;
+        const unsigned end = (owner+1)*num_classes/num_nodes;
+        for (unsigned i=next[owner]++; i < end; i=next[owner]++)
+        {
+          this->transformClass(i, first[i], last[i], store, degradations[t], statistics[t], metrics[t]);
+          m_class_nodes[i] = node;
+          stolen[t] += (owner != node);
+        }
+      }
+      seconds[t] = (static_cast<double>(cv::getTickCount()) - ticks) / cv::getTickFrequency();
+    }));
+  }
+
+  if (m_numa)
+    m_metrics.nodes.resize(num_nodes);
+  for (unsigned t=0; t < num_threads; t++)
+  {
+    workers[t].join();
+    m_statistics.merge(statistics[t]);
+    m_metrics.samples += metrics[t].samples;
+    m_metrics.resampled += metrics[t].resampled;
+    m_metrics.dropped += metrics[t].dropped;
+    if (!m_numa)
+      continue;
+    NodeMetrics &node = m_metrics.nodes[m_topology.workerNode(t)];
+    node.samples += metrics[t].samples;
+    node.stolen += stolen[t];
+    node.transform_seconds = std::max(node.transform_seconds, seconds[t]);
+  }
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method:
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats: only the members of this class are modified.
+//
+// -----------------------------------------------------------------------------
+void
+MyFreetype::transformClass
+  (
+  const unsigned i,
+  const std::vector<unsigned> &first,
+  const std::vector<unsigned> &last,
+  const GlyphStore &store,
+  Degradation &degradation,
+  Statistics &statistics,
+  Metrics &metrics
+  )
+{
+  TRACE_GLYPH("class", i);
+
+  // Repeat images, copied into the memory node of this worker
+  std::vector<cv::Mat> aux = m_images[i];
+  if (m_numa)
+    for (unsigned k=0; k < aux.size(); k++)
+      aux[k] = aux[k].clone();
+  const std::vector<SampleInfo> aux_infos = m_infos[i];
+  const std::vector<cv::Mat> aux_sdfs = m_sdfs[i];
+  const std::vector<cv::Mat> aux_masters = m_masters[i];
+  const unsigned num_images = aux_infos.size();
+  m_images[i].clear();
+  m_infos[i].clear();
+
+  // Compact images are decoded into the same buffer before every sample
+  static thread_local cv::Mat scratch;
+
+  // Glyphs and text line crops are numbered apart, so crops don't move the
+  // seeds of the glyphs
+  std::vector<unsigned> ids(num_images);
+  unsigned num_glyphs = 0, num_crops = 0;
+  for (unsigned short k=0; k < num_images; k++)
+    ids[k] = (aux_infos[k].line == 0) ? num_glyphs++ : num_crops++;
+
+  // Make the random transformations
+  HashIndex index(std::max(m_max_distance, 0));
+  unsigned max_repeats = 0;
+  for (unsigned short k=0; k < num_images; k++)
+    max_repeats = std::max(max_repeats, last[k]);
+  for (unsigned j=0; j < max_repeats; j++)
+  {
+    for (unsigned short k=0; k < num_images; k++)
+    {
+      if ((j < first[k]) || (j >= last[k]))
+        continue;
+
+      // Each sample has its own seed to be reproducible, crops take the upper
+      // half of the sample numbers
+      const unsigned sample = (aux_infos[k].line == 0) ? j*num_glyphs + ids[k] : 0x80000000 | (j*num_crops + ids[k]);
+      cv::RNG rng(sampleSeed(m_seed, i, sample));
+      cv::Mat img = this->baseImage(i, k, store, aux, scratch);
+      SampleInfo info = aux_infos[k];
+      info.repeat = j;
+      info.augmentation = Augmentation();
+      const cv::Mat sdf = (k < aux_sdfs.size()) ? aux_sdfs[k] : cv::Mat();
+      const cv::Mat master = (k < aux_masters.size()) ? aux_masters[k] : cv::Mat();
+      this->transformImage(rng, sdf, master, degradation, img, info.augmentation);
+      if (img.data == scratch.data)
+        img = img.clone();
+      if (m_max_distance < 0)
+      {
+        statistics.add(i, img);
+        m_images[i].push_back(img);
+        m_infos[i].push_back(info);
+        continue;
+      }
+
+      // Resample near-duplicated images of this character
+      uint64_t hash = perceptualHash(img);
+      unsigned attempt = 0;
+      while (index.contains(hash) && (attempt < Constants::DEDUP_RETRIES))
+      {
+        // Operations only record what they apply, so nothing of the rejected
+        // image is kept
+        img = this->baseImage(i, k, store, aux, scratch);
+        info.augmentation = Augmentation();
+        this->transformImage(rng, sdf, master, degradation, img, info.augmentation);
+        if (img.data == scratch.data)
+          img = img.clone();
+        hash = perceptualHash(img);
+        attempt++;
+      }
+      metrics.resampled += attempt;
+      if (index.contains(hash))
+      {
+        metrics.dropped++;
+        continue;
+      }
+      index.insert(hash);
+      statistics.add(i, img);
+      m_images[i].push_back(img);
+      m_infos[i].push_back(info);
+    }
+  }
+  metrics.samples += m_images[i].size();
+  m_sdfs[i].clear();
+  m_masters[i].clear();
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method: repeat 'j' of an image with 'r' repeats is due at
+// '(j+0.5)/r', so sorting every repeat by that time interleaves the images
+// proportionally to their budget (stride scheduling). Each part takes the
+// next 'BUDGET_CHUNK' repeats of that order from the rendered images and is
+// saved in its own directory before the checkpoint moves past it.
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats: near-duplicates are only searched within a part,
+// and the 'statistics.txt' of each part only describes the samples of that
+// part. The checkpoint keeps the seed, and fails with another number of
+// samples.
+//
+// -----------------------------------------------------------------------------
+bool
+MyFreetype::generateBudgeted
+  (
+  const std::string &output_dir,
+  const size_t max_samples,
+  const double max_seconds
+  )
+{
+  const double start = static_cast<double>(cv::getTickCount());
+  std::vector< std::vector<unsigned> > repeats;
+  this->sampleBudget(repeats);
+
+  std::vector< std::pair<unsigned, unsigned> > images;
+  std::vector< std::pair<double, unsigned> > schedule;
+  for (unsigned i=0; i < repeats.size(); i++)
+  {
+    for (unsigned k=0; k < repeats[i].size(); k++)
+    {
+      for (unsigned j=0; j < repeats[i][k]; j++)
+        schedule.push_back(std::make_pair((j + 0.5) / repeats[i][k], images.size()));
+      images.push_back(std::make_pair(i, k));
+    }
+  }
+  std::sort(schedule.begin(), schedule.end());
+
+  // Continue a previous run with its seed
+  const std::string checkpoint = output_dir + Constants::CHECKPOINT_FILE;
+  size_t done = 0;
+  unsigned parts = 0;
+  std::ifstream ifs(checkpoint.c_str());
+  if (ifs.is_open())
+  {
+    size_t units = 0;
+    std::string key;
+    while (ifs >> key)
+    {
+      if (key == "seed")
+        ifs >> m_seed;
+      else if (key == "units")
+        ifs >> units;
+      else if (key == "done")
+        ifs >> done;
+      else if (key == "parts")
+        ifs >> parts;
+    }
+    if (units != schedule.size())
+    {
+      ERROR("Error. Checkpoint " << checkpoint << " has " << units << " samples instead of " << schedule.size());
+      return false;
+    }
+    PRINT("Continue from " << done << " of " << units << " samples");
+  }
+
+  std::vector< std::vector<unsigned> > first(repeats.size()), last(repeats.size());
+  for (unsigned i=0; i < repeats.size(); i++)
+    last[i].assign(repeats[i].size(), 0);
+  for (size_t u=0; u < done; u++)
+    last[images[schedule[u].second].first][images[schedule[u].second].second]++;
+
+  // Text lines are saved with the first part
+  if (done > 0)
+    m_lines.clear();
+
+  const std::vector< std::vector<cv::Mat> > images_base = m_images, sdfs_base = m_sdfs, masters_base = m_masters;
+  const std::vector< std::vector<SampleInfo> > infos_base = m_infos;
+  size_t generated = 0;
+  double part_seconds = 0.0;
+  while (done < schedule.size())
+  {
+    double elapsed = (static_cast<double>(cv::getTickCount()) - start) / cv::getTickFrequency();
+    if ((max_seconds > 0) && (elapsed + part_seconds > max_seconds))
+      break;
+    if ((max_samples > 0) && (generated >= max_samples))
+      break;
+
+    size_t units = std::min<size_t>(Constants::BUDGET_CHUNK, schedule.size() - done);
+    if (max_samples > 0)
+      units = std::min(units, max_samples - generated);
+    first = last;
+    for (size_t u=done; u < done+units; u++)
+      last[images[schedule[u].second].first][images[schedule[u].second].second]++;
+
+    TRACE_STAGE("part", parts);
+    double ticks = static_cast<double>(cv::getTickCount());
+    m_images = images_base;
+    m_infos = infos_base;
+    m_sdfs = sdfs_base;
+    m_masters = masters_base;
+    m_statistics = Statistics(m_images.size());
+    this->transformRepeats(first, last);
+
+    std::ostringstream part_dir;
+    part_dir << output_dir << "part-" << std::setw(6) << std::setfill('0') << parts << "/";
+    boost::filesystem::create_directories(part_dir.str());
+    this->saveImages(part_dir.str().c_str());
+    m_lines.clear();
+
+    // The part reaches the disk before the checkpoint moves past it
+    if (!syncDirectory(part_dir.str()) || !syncPath(output_dir))
+      return false;
+    done += units;
+    generated += units;
+    parts++;
+    if (!this->saveCheckpoint(checkpoint, output_dir, schedule.size(), done, parts))
+      return false;
+    part_seconds = (static_cast<double>(cv::getTickCount()) - ticks) / cv::getTickFrequency();
+  }
+  PRINT("Saved " << done << " of " << schedule.size() << " samples in " << parts << " parts");
+  return true;
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method:
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats: the new file is flushed before the rename and
+// the directory after it, so a crash leaves the previous checkpoint or the
+// new one.
+//
+// -----------------------------------------------------------------------------
+bool
+MyFreetype::saveCheckpoint
+  (
+  const std::string &filename,
+  const std::string &output_dir,
+  const size_t units,
+  const size_t done,
+  const unsigned parts
+  ) const
+{
+  const std::string tmp = filename + ".tmp";
+  std::ofstream ofs(tmp.c_str());
+  ofs << "seed " << m_seed << std::endl;
+  ofs << "units " << units << std::endl;
+  ofs << "done " << done << std::endl;
+  ofs << "parts " << parts << std::endl;
+  ofs.close();
+  if (!ofs)
+  {
+    ERROR("Error. Unable to write " << tmp);
+    return false;
+  }
+  if (!syncPath(tmp))
+    return false;
+  boost::filesystem::rename(tmp, filename);
+  return syncPath(output_dir);
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method: without a budget every image is repeated 'NUM_ITERS+1'
+// times. Otherwise the same total is split between every image of every
+// class proportionally to the error of its character and font.
+// Inputs:
+// Outputs: number of samples of each image of each class
+// Dependencies:
+// Restrictions and Caveats: seeds depend on the repeat and the image, so an
+// uniform budget generates the same samples.
+//
+// -----------------------------------------------------------------------------
 void
-MyFreetype::setCharacters
+MyFreetype::sampleBudget
   (
-  std::vector<unsigned> &characters
+  std::vector< std::vector<unsigned> > &repeats
+  ) const
+{
+  repeats.resize(m_images.size());
+  std::vector<double> weights;
+  for (unsigned i=0; i < m_images.size(); i++)
+  {
+    repeats[i].assign(m_infos[i].size(), Constants::NUM_ITERS+1);
+    std::string character = asciiCode2String(m_characters[i % m_characters.size()]);
+    for (unsigned k=0; k < m_infos[i].size(); k++)
+      weights.push_back(m_budget.weight(character, m_fonts[m_infos[i][k].font]));
+  }
+  if (m_budget.empty())
+    return;
+
+  std::vector<unsigned> counts;
+  Budget::allocate(weights, weights.size()*(Constants::NUM_ITERS+1), counts);
+  unsigned idx = 0;
+  for (unsigned i=0; i < repeats.size(); i++)
+    for (unsigned k=0; k < repeats[i].size(); k++)
+      repeats[i][k] = counts[idx++];
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method:
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats: the affine transformation always writes a new
+// image, so 'img' may share its data with the original glyph. Images with a
+// distance field are scaled and change their weight at once from it.
+//
+// -----------------------------------------------------------------------------
+void
+MyFreetype::transformImage
+  (
+  cv::RNG &rng,
+  const cv::Mat &sdf,
+  const cv::Mat &master,
+  Degradation &degradation,
+  cv::Mat &img,
+  Augmentation &aug
   )
 {
-  // Initialize members
-  m_characters = characters;
-  m_images.resize(m_characters.size());
+  ProfileScope scope("sample");
+  TRACE_SAMPLE("sample");
+  if (!sdf.empty())
+    distanceFieldTransform(rng, sdf, img, aug);
+  else if (!master.empty())
+    supersampledTransform(rng, master, img, aug);
+  else
+    affineTransform(rng, img, aug);
+  smoothTransform(rng, img, aug);
+  modifyPixelsIntensity(rng, img);
+  if (sdf.empty())
+    morphologicTransform(rng, img, aug);
+  anisotropicFilter(rng, img, aug);
+  if (m_degrade)
+    degradation.apply(rng, img, aug);
 }
 
 // -----------------------------------------------------------------------------
@@ -50,49 +943,187 @@ MyFreetype::setCharacters
 //
 // -----------------------------------------------------------------------------
 void
-MyFreetype::generateImagesFromTrueTypeFont
+MyFreetype::saveImages
   (
-  const char *input_dir
+  const char *output_dir
   )
 {
-  // Initialize Freetype library
-  FT_Library library;
-  FT_Init_FreeType(&library);
+  TRACE_STAGE("save");
+  std::vector<int> compression_params;
+  compression_params.push_back(CV_IMWRITE_PNG_COMPRESSION);
+  compression_params.push_back(m_compression);
+  // Shuffled samples always go into shards, raw images bound their PNG size
+  const size_t shard_size = ((m_shuffle_size > 0) && (m_shard_size == 0)) ? static_cast<size_t>(Constants::SHARD_SIZE)*1024*1024 : m_shard_size;
+  ShardWriter shards(output_dir, shard_size);
+  ExternalShuffle *shuffle = NULL;
+  if (m_shuffle_size > 0)
+    shuffle = new ExternalShuffle(std::string(output_dir) + "spill/", (this->memoryUsage() + m_shuffle_size - 1) / m_shuffle_size, m_seed);
+  std::vector<uchar> buffer;
+  std::vector< std::vector<uchar> > buffers(m_batch_size);
+  std::vector<std::string> names;
+  WorkerPool pool(m_encode_threads);
+  for (unsigned short i=0; i < m_images.size(); i++)
+  {
+    // One directory level per size when there are several sizes
+    const CharSize &char_size = m_sizes[i / m_characters.size()];
+    std::string character = asciiCode2String(m_characters[i % m_characters.size()]);
+    std::string mydir;
+    if (m_sizes.size() > 1)
+      mydir = std::to_string(char_size.size) + "_" + std::to_string(char_size.dpi) + "/";
+    mydir += character + "/";
+    names.push_back(mydir.substr(0, mydir.size()-1));
 
-  // Generate a set of character images using a True Type font directory
-  std::ifstream ttf_file;
-  ttf_file.open(input_dir, std::ios::binary);
-  if (ttf_file.is_open())
+    // Create directory
+    boost::filesystem::path mypath(std::string(output_dir) + mydir);
+    if ((shard_size == 0) && !boost::filesystem::exists(mypath))
+      boost::filesystem::create_directories(mypath);
+
+    // Encode a batch in parallel, then stream it into the tar shards or save
+    // each image into a new file
+    for (unsigned first=0; first < m_images[i].size(); first += m_batch_size)
+    {
+      unsigned last = std::min<unsigned>(first + m_batch_size, m_images[i].size());
+      const unsigned node = m_numa ? m_class_nodes[i] : 0;
+      double ticks = static_cast<double>(cv::getTickCount());
+      this->encodeImages(pool, m_images[i], first, last, node, buffers, compression_params);
+      if (m_numa)
+      {
+        m_metrics.nodes[node].encoded += last - first;
+        m_metrics.nodes[node].encode_seconds += (static_cast<double>(cv::getTickCount()) - ticks) / cv::getTickFrequency();
+      }
+      ProfileScope scope("write", last - first);
+      TRACE_STAGE("write", i);
+      for (unsigned j=first; j < last; j++)
+      {
+        const std::vector<uchar> &encoded = buffers[j-first];
+        std::string name = "char_" + character + "_" + std::to_string(j);
+        m_metrics.bytes += encoded.size();
+        if (shuffle != NULL)
+        {
+          shuffle->add(mydir + name, encoded, character);
+          continue;
+        }
+        if (shard_size > 0)
+        {
+          shards.write(mydir + name, encoded, character);
+          continue;
+        }
+        std::ofstream ofs((mypath.string() + name + ".png").c_str(), std::ios::binary);
+        ofs.write(reinterpret_cast<const char*>(encoded.data()), encoded.size());
+      }
+    }
+  }
+
+  if (shuffle != NULL)
   {
-    // Get length of file
-    ttf_file.seekg(0, std::ios::end);
-    std::fstream::pos_type ttf_size = ttf_file.tellg();
-    ttf_file.seekg (0, std::ios::beg);
-    // Allocate memory
-    unsigned char *buffer = new unsigned char[ttf_size];
-    // Read data as a block
-    ttf_file.read((char*)buffer, ttf_size);
-    ttf_file.close();
+    shuffle->write(shards);
+    delete shuffle;
+  }
 
-    // Create a font face object
-    FT_Face face;
-    FT_New_Memory_Face(library, buffer, ttf_size, 0, &face);
+  // Save text lines with the bounding box of each character
+  for (unsigned n=0; n < m_lines.size(); n++)
+  {
+    const TextLine &line = m_lines[n];
+    std::stringstream boxes;
+    for (unsigned k=0; k < line.boxes.size(); k++)
+    {
+      const cv::Rect &box = line.boxes[k];
+      boxes << asciiCode2String(m_characters[line.characters[k]]) << " " << box.x << " " << box.y << " " << box.width << " " << box.height << "\n";
+    }
 
-    // Dump out each Glyph to a Bitmap
-    for (int idx=0; idx < m_characters.size(); idx++)
-      this->writeGlyphAsBitmap(idx, face);
+    std::string mydir;
+    if (m_sizes.size() > 1)
+      mydir = std::to_string(m_sizes[line.size].size) + "_" + std::to_string(m_sizes[line.size].dpi) + "/";
+    mydir += "lines/";
+    std::string name = "line_" + std::to_string(n);
+    if (shard_size > 0)
+    {
+      cv::imencode(".png", line.image, buffer, compression_params);
+      shards.write(mydir + name, buffer, boxes.str(), "txt");
+      continue;
+    }
 
-    // Now that we are done it is safe to delete the memory
-    delete [] buffer;
+    boost::filesystem::path mypath(std::string(output_dir) + mydir);
+    if (!boost::filesystem::exists(mypath))
+      boost::filesystem::create_directories(mypath);
+    cv::imwrite(mypath.string() + name + ".png", line.image, compression_params);
+    std::ofstream ofs((mypath.string() + name + ".txt").c_str());
+    ofs << boxes.str();
+  }
+  shards.close();
+  this->saveProvenance(std::string(output_dir) + "provenance.col");
+  m_statistics.save(std::string(output_dir) + "statistics.txt", names);
+}
 
-    FT_Done_Face(face);
-    FT_Done_FreeType(library);
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method: one row per image in the order they are saved, so the
+// 'class' and 'sample' columns give its file or tar key.
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+void
+MyFreetype::saveProvenance
+  (
+  const std::string &filename
+  )
+{
+  Provenance table;
+  table.setFonts(m_fonts);
+  unsigned cls = table.addColumn("class", 'H');
+  unsigned sample = table.addColumn("sample", 'I');
+  unsigned font = table.addColumn("font", 'H');
+  unsigned size = table.addColumn("size", 'H');
+  unsigned dpi = table.addColumn("dpi", 'H');
+  unsigned angle = table.addColumn("angle", 'b');
+  unsigned repeat = table.addColumn("repeat", 'I');
+  unsigned scale = table.addColumn("scale", 'f');
+  unsigned tx = table.addColumn("tx", 'f');
+  unsigned ty = table.addColumn("ty", 'f');
+  unsigned blur = table.addColumn("blur", 'B');
+  unsigned morphology = table.addColumn("morphology", 'B');
+  unsigned anisotropic = table.addColumn("anisotropic", 'B');
+  unsigned weight = table.addColumn("weight", 'f');
+  unsigned psf = table.addColumn("psf", 'B');
+  unsigned noise = table.addColumn("noise", 'B');
+  unsigned jpeg = table.addColumn("jpeg", 'B');
+  unsigned line = table.addColumn("line", 'I');
+  for (unsigned i=0; i < m_infos.size(); i++)
+  {
+    const CharSize &char_size = m_sizes[i / m_characters.size()];
+    for (unsigned j=0; j < m_infos[i].size(); j++)
+    {
+      const SampleInfo &info = m_infos[i][j];
+      table.append<uint16_t>(cls, i);
+      table.append<uint32_t>(sample, j);
+      table.append<uint16_t>(font, info.font);
+      table.append<uint16_t>(size, char_size.size);
+      table.append<uint16_t>(dpi, char_size.dpi);
+      table.append<int8_t>(angle, info.angle);
+      table.append<uint32_t>(repeat, info.repeat);
+      table.append<float>(scale, info.augmentation.scale);
+      table.append<float>(tx, info.augmentation.tx);
+      table.append<float>(ty, info.augmentation.ty);
+      table.append<uint8_t>(blur, info.augmentation.blur);
+      table.append<uint8_t>(morphology, info.augmentation.morphology);
+      table.append<uint8_t>(anisotropic, info.augmentation.anisotropic);
+      table.append<float>(weight, info.augmentation.weight);
+      table.append<uint8_t>(psf, info.augmentation.psf);
+      table.append<uint8_t>(noise, info.augmentation.noise);
+      table.append<uint8_t>(jpeg, info.augmentation.jpeg);
+      table.append<uint32_t>(line, info.line);
+      table.endRow();
+    }
   }
+  table.save(filename);
 }
 
 // -----------------------------------------------------------------------------
 //
-// Purpose and Method:
+// Purpose and Method:  
 // Inputs:
 // Outputs:
 // Dependencies:
@@ -100,32 +1131,123 @@ MyFreetype::generateImagesFromTrueTypeFont
 //
 // -----------------------------------------------------------------------------
 void
-MyFreetype::transformImages
-  ()
+MyFreetype::writeGlyphAsBitmap
+  (
+  const int idx,
+  FT_Face &face
+  )
 {
-  cv::RNG rng(time(NULL));
-  for (unsigned short i=0; i < m_images.size(); i++)
+  ProfileScope scope("render", m_sizes.size() * static_cast<unsigned>(2*Constants::ROTATION_ANGLE + 1));
+  TRACE_GLYPH("glyph", idx);
+
+  // A single size loads the glyph at that size for each rotation, so the
+  // bitmaps stay the hinted ones. Several sizes share the unscaled outline of
+  // the glyph loaded only once, without hinting
+  FT_UInt glyph_index = m_glyphs[idx];
+  const bool single_size = (m_sizes.size() == 1);
+  FT_Glyph outline = NULL;
+  if (single_size)
+    FT_Set_Char_Size(face, m_sizes[0].size*64, m_sizes[0].size*64, m_sizes[0].dpi, m_sizes[0].dpi);
+  else
+  {
+    FT_Load_Glyph(face, glyph_index, FT_LOAD_NO_SCALE);
+    FT_Get_Glyph(face->glyph, &outline);
+    m_metrics.outlines++;
+  }
+
+  for (unsigned s=0; s < m_sizes.size(); s++)
   {
-    // Repeat images
-    const std::vector<cv::Mat> aux = m_images[i];
-    for (unsigned short j=0; j < Constants::NUM_ITERS; j++)
-      m_images[i].insert(m_images[i].end(), aux.begin(), aux.end());
+    // Scale from font units to 26.6 pixels at this size and resolution
+    double ppem = m_sizes[s].size * m_sizes[s].dpi / 72.0;
+    double scale = single_size ? 1.0 : ppem * 64.0 / face->units_per_EM;
 
-    // Make the random transformations
-    for (unsigned short j=0; j < m_images[i].size(); j++)
+    // For each character create a lot of images with different rotations
+    for (double r=-Constants::ROTATION_ANGLE; r <= Constants::ROTATION_ANGLE; r++)
     {
-      affineTransform(rng, m_images[i][j]);
-      smoothTransform(rng, m_images[i][j]);
-      modifyPixelsIntensity(rng, m_images[i][j]);
-      morphologicTransform(rng, m_images[i][j]);
-      anisotropicFilter(rng, m_images[i][j]);
+      // Set up a transformation matrix
+      FT_Matrix matrix;
+      double angle = r * (2.0*M_PI)/360.0;
+      matrix.xx = (FT_Fixed)( scale * cos(angle) * 0x10000L);
+      matrix.xy = (FT_Fixed)(-scale * sin(angle) * 0x10000L);
+      matrix.yx = (FT_Fixed)( scale * sin(angle) * 0x10000L);
+      matrix.yy = (FT_Fixed)( scale * cos(angle) * 0x10000L);
+
+      FT_Glyph glyph;
+      if (single_size)
+      {
+        FT_Vector pen;
+        pen.x = 0;
+        pen.y = 0;
+        FT_Set_Transform(face, &matrix, &pen);
+        FT_Load_Glyph(face, glyph_index, FT_LOAD_DEFAULT);
+        FT_Get_Glyph(face->glyph, &glyph);
+        m_metrics.outlines++;
+      }
+      else
+      {
+        FT_Glyph_Copy(outline, &glyph);
+        FT_Glyph_Transform(glyph, &matrix, 0);
+      }
+
+      // Keep the outline for the distance field and the supersampled bitmap
+      FT_Glyph sdf_glyph = NULL, master_glyph = NULL;
+      if (m_sdf)
+        FT_Glyph_Copy(glyph, &sdf_glyph);
+      if (m_supersample > 0)
+        FT_Glyph_Copy(glyph, &master_glyph);
+
+      // Convert The Glyph To A Bitmap
+      FT_Glyph_To_Bitmap(&glyph, FT_RENDER_MODE_NORMAL, 0, 1);
+      FT_BitmapGlyph bitmap_glyph = (FT_BitmapGlyph)glyph;
+
+      // This reference will make accessing the bitmap easier
+      FT_Bitmap &bitmap = bitmap_glyph->bitmap;
+
+      // Create the grayscale image
+      int width = bitmap.width;
+      int height = bitmap.rows;
+      cv::Mat image = cv::Mat(height, width, CV_8UC1);
+      for (int row = 0; row < height; row++)
+      {
+        for (int col = 0; col < width; col++)
+        {
+          uchar pixel = static_cast<uchar>(bitmap.buffer[col + bitmap.pitch*row]);
+          image.at<uchar>(cv::Point(col, row)) = pixel;
+        }
+      }
+
+      // Store the image
+      SampleInfo info;
+      info.font = m_fonts.size()-1;
+      info.angle = r;
+      this->storeImage(s*m_characters.size() + idx, image);
+      m_infos[s*m_characters.size() + idx].push_back(info);
+      m_metrics.bitmaps++;
+      if (m_sdf)
+      {
+        m_sdfs[s*m_characters.size() + idx].push_back(this->glyphDistanceField(sdf_glyph, bitmap_glyph->left, bitmap_glyph->top, image.size()));
+        FT_Done_Glyph(sdf_glyph);
+      }
+      if (m_supersample > 0)
+      {
+        m_masters[s*m_characters.size() + idx].push_back(this->glyphCoverage(master_glyph, bitmap_glyph->left, bitmap_glyph->top, image.size(), m_supersample));
+        FT_Done_Glyph(master_glyph);
+      }
+
+      // Clean up afterwards
+      FT_Done_Glyph(glyph);
     }
   }
+  if (single_size)
+    FT_Set_Transform(face, NULL, NULL);
+  else
+    FT_Done_Glyph(outline);
 }
 
 // -----------------------------------------------------------------------------
 //
-// Purpose and Method:
+// Purpose and Method: images are interleaved between the threads. Threads
+// of the pool only move to another node when the batch does.
 // Inputs:
 // Outputs:
 // Dependencies:
@@ -133,35 +1255,96 @@ MyFreetype::transformImages
 //
 // -----------------------------------------------------------------------------
 void
-MyFreetype::saveImages
+MyFreetype::encodeImages
   (
-  const char *output_dir
-  )
+  WorkerPool &pool,
+  const std::vector<cv::Mat> &images,
+  const unsigned first,
+  const unsigned last,
+  const unsigned node,
+  std::vector< std::vector<uchar> > &buffers,
+  const std::vector<int> &params
+  ) const
 {
-  std::vector<int> compression_params;
-  compression_params.push_back(CV_IMWRITE_PNG_COMPRESSION);
-  compression_params.push_back(3);
-  for (unsigned short i=0; i < m_images.size(); i++)
+  const unsigned num_threads = std::min(pool.size(), last - first);
+  pool.run([&](unsigned t)
   {
-    // Create directory
-    std::string character = asciiCode2String(m_characters[i]);
-    std::string mydir(output_dir);
-    boost::filesystem::path mypath(mydir + character + "/");
-    if (!boost::filesystem::exists(mypath))
-      boost::filesystem::create_directory(mypath);
+    if (t >= num_threads)
+      return;
+    static thread_local int pinned = -1;
+    setProfileThread(t+1);
+    if (m_numa && (pinned != static_cast<int>(node)))
+    {
+      Topology::pinThread(m_topology.cpus(node));
+      pinned = node;
+    }
+    ProfileScope scope("encode", (last - first - t + num_threads - 1) / num_threads);
+    TRACE_STAGE("encode", node);
+    for (unsigned j=first+t; j < last; j+=num_threads)
+    {
+      TRACE_SAMPLE("png", j);
+      cv::imencode(".png", images[j], buffers[j-first], params);
+    }
+  });
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method:
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+size_t
+MyFreetype::memoryUsage
+  () const
+{
+  size_t bytes = 0;
+  for (unsigned i=0; i < m_images.size(); i++)
+  {
+    for (unsigned j=0; j < m_images[i].size(); j++)
+      bytes += m_images[i][j].total() * m_images[i][j].elemSize();
+    for (unsigned j=0; j < m_sdfs[i].size(); j++)
+      bytes += m_sdfs[i][j].total() * m_sdfs[i][j].elemSize();
+    for (unsigned j=0; j < m_masters[i].size(); j++)
+      bytes += m_masters[i][j].total();
+  }
+  for (unsigned n=0; n < m_lines.size(); n++)
+    bytes += m_lines[n].image.total();
+  return bytes + m_store.bytes();
+}
 
-    // Save each image into a new file
-    for (unsigned short j=0; j < m_images[i].size(); j++)
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method:
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+void
+MyFreetype::getBaseImages
+  (
+  std::vector< std::vector<cv::Mat> > &images
+  ) const
+{
+  images = m_images;
+  for (unsigned i=0; i < m_tiles.size(); i++)
+  {
+    for (unsigned k=0; k < m_tiles[i].size(); k++)
     {
-      std::string aux(mypath.string() + "char_" + character + "_" + std::to_string(j) + ".png");
-      cv::imwrite(aux, m_images[i][j], compression_params);
+      images[i].push_back(cv::Mat());
+      m_store.decode(m_tiles[i][k], images[i].back());
     }
   }
 }
 
 // -----------------------------------------------------------------------------
 //
-// Purpose and Method:  
+// Purpose and Method:
 // Inputs:
 // Outputs:
 // Dependencies:
@@ -169,64 +1352,285 @@ MyFreetype::saveImages
 //
 // -----------------------------------------------------------------------------
 void
-MyFreetype::writeGlyphAsBitmap
+MyFreetype::storeImage
   (
-  const int idx,
-  FT_Face &face
+  const unsigned i,
+  const cv::Mat &image
   )
 {
-  // Set the size to use at 200dpi
-  FT_Set_Char_Size(face, Constants::CHAR_SIZE*64, Constants::CHAR_SIZE*64, 200, 200);
+  if (m_compact)
+    m_tiles[i].push_back(m_store.add(image));
+  else
+    m_images[i].push_back(image);
+}
 
-  // For each character create a lot of images with different rotations
-  for (double r=-Constants::ROTATION_ANGLE; r <= Constants::ROTATION_ANGLE; r++)
-  {
-    // Set up a transformation matrix
-    FT_Matrix matrix;
-    double angle = r * (2.0*M_PI)/360.0;
-    matrix.xx = (FT_Fixed)( cos(angle) * 0x10000L);
-    matrix.xy = (FT_Fixed)(-sin(angle) * 0x10000L);
-    matrix.yx = (FT_Fixed)( sin(angle) * 0x10000L);
-    matrix.yy = (FT_Fixed)( cos(angle) * 0x10000L);
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method:
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats: the result shares the scratch buffer, which is
+// overwritten by the next call.
+//
+// -----------------------------------------------------------------------------
+cv::Mat
+MyFreetype::baseImage
+  (
+  const unsigned i,
+  const unsigned k,
+  const GlyphStore &store,
+  const std::vector<cv::Mat> &images,
+  cv::Mat &scratch
+  ) const
+{
+  if (m_tiles[i].empty())
+    return images[k];
+  store.decode(m_tiles[i][k], scratch);
+  return scratch;
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method: the outline is moved to the bitmap origin and scaled,
+// so each pixel of the bitmap covers 'scale' x 'scale' pixels.
+// Inputs: outline glyph, left and top of its bitmap and size of the bitmap
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats: the outline is modified.
+//
+// -----------------------------------------------------------------------------
+cv::Mat
+MyFreetype::glyphCoverage
+  (
+  FT_Glyph glyph,
+  const int left,
+  const int top,
+  const cv::Size &size,
+  const unsigned scale
+  ) const
+{
+  if ((size.area() == 0) || (glyph->format != FT_GLYPH_FORMAT_OUTLINE))
+    return cv::Mat();
 
-    FT_Vector pen;
-    pen.x = 0;
-    pen.y = 0;
+  FT_Outline &outline = reinterpret_cast<FT_OutlineGlyph>(glyph)->outline;
+  FT_Outline_Translate(&outline, -left*64, -(top - size.height)*64);
+  FT_Matrix matrix;
+  matrix.xx = matrix.yy = scale * 0x10000L;
+  matrix.xy = matrix.yx = 0;
+  FT_Outline_Transform(&outline, &matrix);
+
+  cv::Mat coverage = cv::Mat::zeros(size.height*scale, size.width*scale, CV_8UC1);
+  FT_Bitmap bitmap;
+  memset(&bitmap, 0, sizeof(bitmap));
+  bitmap.rows = coverage.rows;
+  bitmap.width = coverage.cols;
+  bitmap.pitch = coverage.cols;
+  bitmap.buffer = coverage.data;
+  bitmap.num_grays = 256;
+  bitmap.pixel_mode = FT_PIXEL_MODE_GRAY;
+  FT_Outline_Get_Bitmap(glyph->library, &outline, &bitmap);
+  return coverage;
+}
 
-    FT_Set_Transform(face, &matrix, &pen);
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method: the outline is moved to the bitmap origin, rendered
+// 'SDF_SCALE' times bigger and each pixel stores its distance to the edge,
+// positive outside and negative inside. Antialiased pixels lie on the edge
+// and take their distance from the coverage.
+// Inputs: outline glyph, left and top of its bitmap and size of the bitmap
+// Outputs: floating point distances in pixels of the bitmap
+// Dependencies:
+// Restrictions and Caveats: the outline is modified.
+//
+// -----------------------------------------------------------------------------
+cv::Mat
+MyFreetype::glyphDistanceField
+  (
+  FT_Glyph glyph,
+  const int left,
+  const int top,
+  const cv::Size &size
+  ) const
+{
+  const int scale = Constants::SDF_SCALE;
+  cv::Mat coverage = this->glyphCoverage(glyph, left, top, size, scale);
+  if (coverage.empty())
+    return cv::Mat();
 
-    // Load the glyph we are looking for
-    FT_UInt glyph_index = m_characters[idx];
-    FT_Load_Glyph(face, glyph_index, FT_LOAD_DEFAULT);
+  // Distance to the nearest pixel on the other side of the edge
+  cv::Mat inside = coverage >= 128;
+  cv::Mat outside = coverage < 128;
+  cv::Mat dist_in, dist_out;
+  cv::distanceTransform(inside, dist_in, CV_DIST_L2, CV_DIST_MASK_PRECISE);
+  cv::distanceTransform(outside, dist_out, CV_DIST_L2, CV_DIST_MASK_PRECISE);
 
-    FT_Glyph glyph;
-    FT_Get_Glyph(face->glyph, &glyph);
+  cv::Mat sdf(coverage.size(), CV_32F);
+  for (int row=0; row < sdf.rows; row++)
+  {
+    const uchar *pixels = coverage.ptr<uchar>(row);
+    const float *in = dist_in.ptr<float>(row);
+    const float *out = dist_out.ptr<float>(row);
+    float *distances = sdf.ptr<float>(row);
+    for (int col=0; col < sdf.cols; col++)
+    {
+      float distance;
+      if ((pixels[col] > 0) && (pixels[col] < 255))
+        distance = 0.5f - pixels[col]/255.0f;
+      else if (pixels[col] == 0)
+        distance = out[col] - 0.5f;
+      else
+        distance = 0.5f - in[col];
+      distances[col] = distance / scale;
+    }
+  }
+  return sdf;
+}
 
-    // Convert The Glyph To A Bitmap
-    FT_Glyph_To_Bitmap(&glyph, FT_RENDER_MODE_NORMAL, 0, 1);
-    FT_BitmapGlyph bitmap_glyph = (FT_BitmapGlyph)glyph;
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method: the outlines of a line are merged in a single outline
+// so that touching characters are rasterized together. Characters are crops
+// of the line padded by a fraction of their width.
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats: lines have their own seeds apart from the
+// samples, and the crops are numbered apart from the glyphs when they are
+// transformed, so they don't change the transformations of the glyphs.
+//
+// -----------------------------------------------------------------------------
+void
+MyFreetype::writeTextLines
+  (
+  FT_Library &library,
+  FT_Face &face
+  )
+{
+  ProfileScope scope("lines", m_sizes.size() * m_num_lines);
+  TRACE_STAGE("lines");
+  const unsigned font = m_fonts.size()-1;
+  cv::RNG rng(sampleSeed(m_seed, 0xFFFFFFFF, font));
+  for (unsigned s=0; s < m_sizes.size(); s++)
+  {
+    FT_Set_Char_Size(face, m_sizes[s].size*64, m_sizes[s].size*64, m_sizes[s].dpi, m_sizes[s].dpi);
 
-    // This reference will make accessing the bitmap easier
-    FT_Bitmap &bitmap = bitmap_glyph->bitmap;
+    // Scaled outline of each character
+    std::vector<FT_Glyph> outlines(m_characters.size(), static_cast<FT_Glyph>(NULL));
+    for (unsigned idx=0; idx < m_characters.size(); idx++)
+    {
+      if (FT_Load_Glyph(face, m_glyphs[idx], FT_LOAD_NO_BITMAP) != 0)
+        continue;
+      if (face->glyph->format == FT_GLYPH_FORMAT_OUTLINE)
+        FT_Get_Glyph(face->glyph, &outlines[idx]);
+    }
 
-    // Create the grayscale image
-    int width = bitmap.width;
-    int height = bitmap.rows;
-    cv::Mat image = cv::Mat(height, width, CV_8UC1);
-    for (int row = 0; row < height; row++)
+    const int margin = Constants::LINE_MARGIN;
+    const int baseline = (-face->size->metrics.descender >> 6) + margin;
+    const int height = ((face->size->metrics.ascender - face->size->metrics.descender) >> 6) + 2*margin;
+    for (unsigned n=0; n < m_num_lines; n++)
     {
-      for (int col = 0; col < width; col++)
+      // Random string laid out with advances, kerning and random spacing
+      std::vector<unsigned> text;
+      std::vector<FT_Pos> pens;
+      FT_Pos pen = margin*64;
+      FT_UInt previous = 0;
+      int num_points = 0, num_contours = 0;
+      for (unsigned k=0; k < m_line_length; k++)
       {
-    	uchar pixel = static_cast<uchar>(bitmap.buffer[col + bitmap.width*row]);
-    	image.at<uchar>(cv::Point(col, row)) = pixel;
+        unsigned idx = rng.uniform(0, static_cast<int>(m_characters.size()));
+        if (outlines[idx] == NULL)
+          continue;
+        FT_Outline &outline = reinterpret_cast<FT_OutlineGlyph>(outlines[idx])->outline;
+        if (num_points + outline.n_points > FT_OUTLINE_POINTS_MAX)
+          break;
+        if (FT_HAS_KERNING(face) && previous)
+        {
+          FT_Vector delta;
+          FT_Get_Kerning(face, previous, m_glyphs[idx], FT_KERNING_DEFAULT, &delta);
+          pen += delta.x;
+        }
+        pen = std::max<FT_Pos>((pen + 32) & ~63, 0);
+        text.push_back(idx);
+        pens.push_back(pen);
+        pen += (outlines[idx]->advance.x >> 10) + rng.uniform(-1, 3)*64;
+        previous = m_glyphs[idx];
+        num_points += outline.n_points;
+        num_contours += outline.n_contours;
       }
-    }
+      if (text.empty())
+        continue;
 
-    // Store the image
-    m_images[idx].push_back(image);
+      // Merge the translated outlines
+      FT_Outline line;
+      FT_Outline_New(library, num_points, num_contours, &line);
+      line.n_points = 0;
+      line.n_contours = 0;
+      line.flags = reinterpret_cast<FT_OutlineGlyph>(outlines[text[0]])->outline.flags;
+      for (unsigned k=0; k < text.size(); k++)
+      {
+        const FT_Outline &outline = reinterpret_cast<FT_OutlineGlyph>(outlines[text[k]])->outline;
+        for (int p=0; p < outline.n_points; p++)
+        {
+          line.points[line.n_points + p].x = outline.points[p].x + pens[k];
+          line.points[line.n_points + p].y = outline.points[p].y + baseline*64;
+          line.tags[line.n_points + p] = outline.tags[p];
+        }
+        for (int c=0; c < outline.n_contours; c++)
+          line.contours[line.n_contours + c] = outline.contours[c] + line.n_points;
+        line.n_points += outline.n_points;
+        line.n_contours += outline.n_contours;
+      }
+
+      // Rasterize the line once, the bitmap origin is its bottom left corner
+      const int width = (pen >> 6) + 2*margin;
+      TextLine text_line;
+      text_line.size = s;
+      text_line.image = cv::Mat::zeros(height, width, CV_8UC1);
+      FT_Bitmap bitmap;
+      memset(&bitmap, 0, sizeof(bitmap));
+      bitmap.rows = height;
+      bitmap.width = width;
+      bitmap.pitch = width;
+      bitmap.buffer = text_line.image.data;
+      bitmap.num_grays = 256;
+      bitmap.pixel_mode = FT_PIXEL_MODE_GRAY;
+      FT_Outline_Get_Bitmap(library, &line, &bitmap);
+      FT_Outline_Done(library, &line);
+
+      // Crop each character with part of its neighbours
+      const cv::Rect canvas(0, 0, width, height);
+      for (unsigned k=0; k < text.size(); k++)
+      {
+        FT_BBox bbox;
+        FT_Glyph_Get_CBox(outlines[text[k]], FT_GLYPH_BBOX_PIXELS, &bbox);
+        cv::Rect box((pens[k] >> 6) + bbox.xMin, height - baseline - bbox.yMax, bbox.xMax - bbox.xMin, bbox.yMax - bbox.yMin);
+        box = box & canvas;
+        text_line.characters.push_back(text[k]);
+        text_line.boxes.push_back(box);
+
+        int pad = cvRound(Constants::LINE_CONTEXT*box.width);
+        cv::Rect crop = cv::Rect(box.x - pad, box.y - pad, box.width + 2*pad, box.height + 2*pad) & canvas;
+        if (crop.area() == 0)
+          continue;
+        SampleInfo info;
+        info.font = font;
+        info.line = m_lines.size()+1;
+        this->storeImage(s*m_characters.size() + text[k], text_line.image(crop).clone());
+        m_infos[s*m_characters.size() + text[k]].push_back(info);
+        if (m_sdf)
+          m_sdfs[s*m_characters.size() + text[k]].push_back(cv::Mat());
+        if (m_supersample > 0)
+          m_masters[s*m_characters.size() + text[k]].push_back(cv::Mat());
+        m_metrics.bitmaps++;
+      }
+      m_lines.push_back(text_line);
+    }
 
-    // Clean up afterwards
-    FT_Done_Glyph(glyph);
+    for (unsigned idx=0; idx < outlines.size(); idx++)
+      if (outlines[idx] != NULL)
+        FT_Done_Glyph(outlines[idx]);
   }
 }
 
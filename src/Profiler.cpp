@@ -0,0 +1,370 @@
+/** ****************************************************************************
+ *  @file    Profiler.cpp
+ *  @brief   Hardware performance counters of each stage and thread.
+ *  @author  Roberto Valle Fernandez.
+ *  @date    2012/01
+ *  @copyright All rights reserved.
+ *  Escuela Tecnica Superior de Ingenieria Informatica (Computer Science School)
+ *  Universidad Rey Juan Carlos (Spain)
+ ******************************************************************************/
+
+// ----------------------- INCLUDES --------------------------------------------
+#include <Profiler.hpp>
+#include <trace.hpp>
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <algorithm>
+#include <fstream>
+#include <cstring>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+namespace urjc {
+
+/**
+ * @brief Counters accumulated by a stage in a thread.
+ */
+struct StageCounters
+{
+  StageCounters() : calls(0), samples(0) { memset(values, 0, sizeof(values)); };
+  uint64_t calls, samples;
+  uint64_t values[PROFILE_EVENTS];
+};
+
+/**
+ * @brief Counters of a thread, merged into the global table when it ends.
+ */
+struct ThreadProfile
+{
+  ThreadProfile();
+  ~ThreadProfile();
+
+  bool
+  read
+    (
+    uint64_t values[PROFILE_EVENTS]
+    ) const;
+
+  void
+  flush
+    ();
+
+  unsigned index;
+  int leader;
+  // Descriptor of each event, or -1 if it couldn't be opened
+  int fds[PROFILE_EVENTS];
+  // Position of each event in the group, or -1 if it couldn't be opened
+  int positions[PROFILE_EVENTS];
+  unsigned num_opened;
+  std::map<std::string, StageCounters> stages;
+};
+
+static std::atomic<bool> g_enabled(false);
+static std::mutex g_mutex;
+static std::map< std::pair<std::string, unsigned>, StageCounters > g_stages;
+
+static const char *EVENT_NAMES[PROFILE_EVENTS] = {"cycles", "instructions", "cache_misses", "branch_misses", "page_faults"};
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method: only user space is counted, which is allowed with the
+// default 'perf_event_paranoid' level.
+// Inputs:
+// Outputs: file descriptor or -1
+// Dependencies: Linux perf_event_open system call
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+static int
+openEvent
+  (
+  const uint32_t type,
+  const uint64_t config,
+  const int group
+  )
+{
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = type;
+  attr.config = config;
+  attr.disabled = (group == -1) ? 1 : 0;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  attr.read_format = PERF_FORMAT_GROUP;
+  return static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, group, 0));
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method: the events are opened as a single group, so one read
+// returns all of them measured over the same interval. Events the machine
+// doesn't support are skipped.
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+ThreadProfile::ThreadProfile
+  ()
+{
+  const uint32_t types[PROFILE_EVENTS] = {PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_SOFTWARE};
+  const uint64_t configs[PROFILE_EVENTS] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES, PERF_COUNT_SW_PAGE_FAULTS};
+  index = 0;
+  leader = -1;
+  num_opened = 0;
+  for (unsigned e=0; e < PROFILE_EVENTS; e++)
+  {
+    positions[e] = -1;
+    fds[e] = openEvent(types[e], configs[e], leader);
+    if (fds[e] < 0)
+      continue;
+    if (leader < 0)
+      leader = fds[e];
+    positions[e] = num_opened++;
+  }
+  if (leader >= 0)
+    ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method:
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats: each event of the group has its own descriptor,
+// closing the leader doesn't close the others.
+//
+// -----------------------------------------------------------------------------
+ThreadProfile::~ThreadProfile
+  ()
+{
+  this->flush();
+  for (unsigned e=0; e < PROFILE_EVENTS; e++)
+    if (fds[e] >= 0)
+      close(fds[e]);
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method:
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+bool
+ThreadProfile::read
+  (
+  uint64_t values[PROFILE_EVENTS]
+  ) const
+{
+  uint64_t buffer[PROFILE_EVENTS+1];
+  if ((leader < 0) || (::read(leader, buffer, sizeof(buffer)) < static_cast<ssize_t>(sizeof(uint64_t))))
+    return false;
+  for (unsigned e=0; e < PROFILE_EVENTS; e++)
+    values[e] = (positions[e] >= 0) ? buffer[1 + positions[e]] : 0;
+  return true;
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method:
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+void
+ThreadProfile::flush
+  ()
+{
+  std::lock_guard<std::mutex> lock(g_mutex);
+  for (std::map<std::string, StageCounters>::const_iterator it=stages.begin(); it != stages.end(); it++)
+  {
+    StageCounters &counters = g_stages[std::make_pair(it->first, index)];
+    counters.calls += it->second.calls;
+    counters.samples += it->second.samples;
+    for (unsigned e=0; e < PROFILE_EVENTS; e++)
+      counters.values[e] += it->second.values[e];
+  }
+  stages.clear();
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method: each thread keeps its profile until it exits.
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+static ThreadProfile*
+threadProfile
+  ()
+{
+  static thread_local ThreadProfile profile;
+  return &profile;
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method:
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+bool
+enableProfiling
+  ()
+{
+  ThreadProfile *profile = threadProfile();
+  if (profile->leader < 0)
+  {
+    ERROR("Error. Performance counters can't be opened, check /proc/sys/kernel/perf_event_paranoid");
+    return false;
+  }
+  g_enabled = true;
+  return true;
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method:
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+void
+setProfileThread
+  (
+  const unsigned index
+  )
+{
+  if (g_enabled)
+    threadProfile()->index = index;
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method: one row per stage and thread plus one row per stage for
+// all threads, with the instructions per cycle and the misses per sample.
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats: threads still running are not included, except
+// the calling one.
+//
+// -----------------------------------------------------------------------------
+bool
+saveProfile
+  (
+  const std::string &filename
+  )
+{
+  if (!g_enabled)
+    return false;
+  threadProfile()->flush();
+
+  std::ofstream ofs(filename.c_str());
+  if (!ofs.is_open())
+  {
+    ERROR("Error. File " << filename << " can't be opened");
+    return false;
+  }
+
+  std::lock_guard<std::mutex> lock(g_mutex);
+  std::map<std::string, StageCounters> totals;
+  for (std::map< std::pair<std::string, unsigned>, StageCounters >::const_iterator it=g_stages.begin(); it != g_stages.end(); it++)
+  {
+    StageCounters &total = totals[it->first.first];
+    total.calls += it->second.calls;
+    total.samples += it->second.samples;
+    for (unsigned e=0; e < PROFILE_EVENTS; e++)
+      total.values[e] += it->second.values[e];
+  }
+
+  ofs << "# stage thread calls samples";
+  for (unsigned e=0; e < PROFILE_EVENTS; e++)
+    ofs << " " << EVENT_NAMES[e];
+  ofs << " ipc cache_misses_per_sample branch_misses_per_sample page_faults_per_sample\n";
+  std::map< std::pair<std::string, unsigned>, StageCounters >::const_iterator row = g_stages.begin();
+  for (std::map<std::string, StageCounters>::const_iterator it=totals.begin(); it != totals.end(); it++)
+  {
+    for (; ; row++)
+    {
+      const bool total = (row == g_stages.end()) || (row->first.first != it->first);
+      const StageCounters &counters = total ? it->second : row->second;
+      ofs << it->first << " " << (total ? std::string("all") : std::to_string(row->first.second)) << " " << counters.calls << " " << counters.samples;
+      for (unsigned e=0; e < PROFILE_EVENTS; e++)
+        ofs << " " << counters.values[e];
+      double samples = std::max<double>(counters.samples, 1.0);
+      ofs << " " << ((counters.values[0] > 0) ? static_cast<double>(counters.values[1]) / counters.values[0] : 0.0)
+          << " " << counters.values[2] / samples << " " << counters.values[3] / samples << " " << counters.values[4] / samples << "\n";
+      if (total)
+        break;
+    }
+  }
+  return true;
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method:
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+ProfileScope::ProfileScope
+  (
+  const char *stage,
+  const unsigned samples
+  )
+{
+  m_stage = stage;
+  m_samples = samples;
+  m_active = g_enabled && threadProfile()->read(m_start);
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method:
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats: the counters of a thread are only opened when
+// profiling is enabled.
+//
+// -----------------------------------------------------------------------------
+ProfileScope::~ProfileScope
+  ()
+{
+  if (!m_active)
+    return;
+  uint64_t end[PROFILE_EVENTS];
+  ThreadProfile *profile = threadProfile();
+  if (!profile->read(end))
+    return;
+
+  StageCounters &counters = profile->stages[m_stage];
+  counters.calls++;
+  counters.samples += m_samples;
+  for (unsigned e=0; e < PROFILE_EVENTS; e++)
+    counters.values[e] += end[e] - m_start[e];
+}
+
+} // close namespace urjc
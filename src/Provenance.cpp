@@ -0,0 +1,279 @@
+/** ****************************************************************************
+ *  @file    Provenance.cpp
+ *  @brief   Columnar table with the origin and parameters of each sample.
+ *  @author  Roberto Valle Fernandez.
+ *  @date    2012/01
+ *  @copyright All rights reserved.
+ *  Escuela Tecnica Superior de Ingenieria Informatica (Computer Science School)
+ *  Universidad Rey Juan Carlos (Spain)
+ ******************************************************************************/
+
+// ----------------------- INCLUDES --------------------------------------------
+#include <Provenance.hpp>
+#include <utils.hpp>
+#include <trace.hpp>
+
+#include <fstream>
+#include <sstream>
+
+namespace urjc {
+
+const char PROVENANCE_MAGIC[4] = { 'G', 'D', 'B', 'P' };
+const uint32_t PROVENANCE_VERSION = 1;
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method:
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+size_t
+typeWidth
+  (
+  const char type
+  )
+{
+  switch (type)
+  {
+    case 'B': case 'b': return 1;
+    case 'H': return 2;
+    case 'I': case 'f': return 4;
+    default: return 0;
+  }
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method:
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+unsigned
+Provenance::addColumn
+  (
+  const std::string &name,
+  const char type
+  )
+{
+  m_names.push_back(name);
+  m_types.push_back(type);
+  m_data.push_back(std::vector<unsigned char>());
+  return m_names.size()-1;
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method:
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+int
+Provenance::findColumn
+  (
+  const std::string &name
+  ) const
+{
+  for (unsigned i=0; i < m_names.size(); i++)
+    if (m_names[i].compare(name)==0)
+      return i;
+  return -1;
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method:
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+double
+Provenance::value
+  (
+  const unsigned col,
+  const size_t row
+  ) const
+{
+  const unsigned char *data = &m_data[col][row*typeWidth(m_types[col])];
+  switch (m_types[col])
+  {
+    case 'B': return *data;
+    case 'b': return *reinterpret_cast<const int8_t*>(data);
+    case 'H': { uint16_t v; memcpy(&v, data, sizeof(v)); return v; }
+    case 'I': { uint32_t v; memcpy(&v, data, sizeof(v)); return v; }
+    case 'f': { float v; memcpy(&v, data, sizeof(v)); return v; }
+    default: return 0.0;
+  }
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method: a single sequential pass over the column.
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+void
+Provenance::filter
+  (
+  const std::string &name,
+  const double min,
+  const double max,
+  std::vector<unsigned char> &mask
+  ) const
+{
+  if (mask.empty())
+    mask.assign(m_rows, 1);
+
+  int col = this->findColumn(name);
+  if (col < 0)
+  {
+    ERROR("Error. Column " << name << " doesn't exist");
+    return;
+  }
+  for (size_t row=0; row < m_rows; row++)
+  {
+    double v = this->value(col, row);
+    if ((v < min) || (v > max))
+      mask[row] = 0;
+  }
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method:
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+bool
+Provenance::load
+  (
+  const std::string &filename
+  )
+{
+  std::ifstream ifs(filename.c_str(), std::ios::binary);
+  if (!ifs.is_open())
+  {
+    ERROR("Error. File " << filename << " can't be opened");
+    return false;
+  }
+
+  char magic[4];
+  uint32_t version = 0, num_fonts = 0, num_columns = 0;
+  uint64_t rows = 0;
+  ifs.read(magic, sizeof(magic));
+  readValue(ifs, version);
+  if ((memcmp(magic, PROVENANCE_MAGIC, sizeof(magic)) != 0) || (version != PROVENANCE_VERSION))
+  {
+    ERROR("Error. File " << filename << " is not a provenance table");
+    return false;
+  }
+  readValue(ifs, rows);
+  m_rows = rows;
+
+  readValue(ifs, num_fonts);
+  m_fonts.resize(num_fonts);
+  for (unsigned i=0; i < num_fonts; i++)
+    readString(ifs, m_fonts[i]);
+
+  readValue(ifs, num_columns);
+  m_names.resize(num_columns);
+  m_types.resize(num_columns);
+  m_data.resize(num_columns);
+  std::vector<uint64_t> offsets(num_columns);
+  for (unsigned i=0; i < num_columns; i++)
+  {
+    readString(ifs, m_names[i]);
+    readValue(ifs, m_types[i]);
+    readValue(ifs, offsets[i]);
+  }
+  for (unsigned i=0; i < num_columns; i++)
+  {
+    m_data[i].resize(m_rows*typeWidth(m_types[i]));
+    ifs.seekg(offsets[i]);
+    if (!m_data[i].empty())
+      ifs.read(reinterpret_cast<char*>(&m_data[i][0]), m_data[i].size());
+  }
+  return static_cast<bool>(ifs);
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method: the header is built in memory first to know where the
+// data of each column starts.
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+bool
+Provenance::save
+  (
+  const std::string &filename
+  ) const
+{
+  std::ofstream ofs(filename.c_str(), std::ios::binary);
+  if (!ofs.is_open())
+  {
+    ERROR("Error. File " << filename << " can't be opened");
+    return false;
+  }
+
+  std::stringstream header;
+  uint64_t rows = m_rows;
+  uint32_t num_fonts = m_fonts.size(), num_columns = m_names.size();
+  header.write(PROVENANCE_MAGIC, sizeof(PROVENANCE_MAGIC));
+  writeValue(header, PROVENANCE_VERSION);
+  writeValue(header, rows);
+  writeValue(header, num_fonts);
+  for (unsigned i=0; i < num_fonts; i++)
+    writeString(header, m_fonts[i]);
+  writeValue(header, num_columns);
+
+  size_t header_size = header.str().size();
+  for (unsigned i=0; i < num_columns; i++)
+    header_size += sizeof(uint32_t) + m_names[i].size() + sizeof(char) + sizeof(uint64_t);
+
+  uint64_t offset = (header_size + 7) & ~7ULL;
+  std::vector<uint64_t> offsets(num_columns);
+  for (unsigned i=0; i < num_columns; i++)
+  {
+    offsets[i] = offset;
+    offset = (offset + m_data[i].size() + 7) & ~7ULL;
+    writeString(header, m_names[i]);
+    writeValue(header, m_types[i]);
+    writeValue(header, offsets[i]);
+  }
+
+  const char zeros[8] = { 0 };
+  std::string bytes = header.str();
+  ofs.write(bytes.data(), bytes.size());
+  ofs.write(zeros, offsets.empty() ? 0 : offsets[0] - bytes.size());
+  for (unsigned i=0; i < num_columns; i++)
+  {
+    if (!m_data[i].empty())
+      ofs.write(reinterpret_cast<const char*>(&m_data[i][0]), m_data[i].size());
+    size_t end = offsets[i] + m_data[i].size();
+    size_t next = (end + 7) & ~7ULL;
+    ofs.write(zeros, next - end);
+  }
+  return static_cast<bool>(ofs);
+}
+
+} // close namespace urjc
@@ -0,0 +1,221 @@
+/** ****************************************************************************
+ *  @file    ShardWriter.cpp
+ *  @brief   Write samples sequentially into size bounded tar archives.
+ *  @author  Roberto Valle Fernandez.
+ *  @date    2012/01
+ *  @copyright All rights reserved.
+ *  Escuela Tecnica Superior de Ingenieria Informatica (Computer Science School)
+ *  Universidad Rey Juan Carlos (Spain)
+ ******************************************************************************/
+
+// ----------------------- INCLUDES --------------------------------------------
+#include <ShardWriter.hpp>
+#include <trace.hpp>
+
+#include <cstdio>
+#include <cstring>
+
+namespace urjc {
+
+const size_t TAR_BLOCK = 512;
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method:
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+ShardWriter::ShardWriter
+  (
+  const std::string &output_dir,
+  const size_t max_bytes
+  )
+{
+  m_output_dir = output_dir;
+  m_max_bytes = max_bytes;
+  m_offset = 0;
+  m_shard = 0;
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method:
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+ShardWriter::~ShardWriter
+  ()
+{
+  this->close();
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method: ustar stores up to 100 characters in the name field and
+// the leading directories, up to 155 characters, in the prefix field. The
+// split is done at the last '/' that fits both.
+// Inputs: member name
+// Outputs: prefix and name fields, false if the name can't be split
+// Dependencies:
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+bool
+splitTarName
+  (
+  const std::string &member,
+  std::string &prefix,
+  std::string &name
+  )
+{
+  prefix.clear();
+  name = member;
+  if (member.size() <= 100)
+    return true;
+
+  size_t pos = member.rfind('/', 155);
+  while ((pos != std::string::npos) && (pos > 0))
+  {
+    if (member.size()-pos-1 > 100)
+      return false;
+    if (member.size()-pos-1 > 0)
+    {
+      prefix = member.substr(0, pos);
+      name = member.substr(pos+1);
+      return true;
+    }
+    pos = member.rfind('/', pos-1);
+  }
+  return false;
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method: both members of a sample are written in the same shard.
+// Only class labels are copied to the index, other members show their
+// extension instead.
+// Inputs:
+// Outputs: false if the sample is skipped
+// Dependencies:
+// Restrictions and Caveats: a key too long for a ustar header skips the
+// sample, no member or index line is written.
+//
+// -----------------------------------------------------------------------------
+bool
+ShardWriter::write
+  (
+  const std::string &key,
+  const std::vector<unsigned char> &image,
+  const std::string &label,
+  const std::string &label_ext
+  )
+{
+  std::string prefix, name;
+  if (!splitTarName(key + "." + label_ext, prefix, name) || !splitTarName(key + ".png", prefix, name))
+  {
+    ERROR("Error. Tar member name " << key << " is too long, sample skipped");
+    return false;
+  }
+
+  size_t image_blocks = (image.size() + TAR_BLOCK - 1) / TAR_BLOCK;
+  size_t label_blocks = (label.size() + TAR_BLOCK - 1) / TAR_BLOCK;
+  size_t sample_bytes = (2 + image_blocks + label_blocks) * TAR_BLOCK;
+  if (m_tar.is_open() && (m_offset + sample_bytes + 2*TAR_BLOCK > m_max_bytes))
+    this->close();
+
+  if (!m_tar.is_open())
+  {
+    char name[32];
+    sprintf(name, "shard-%06u", m_shard);
+    m_tar.open((m_output_dir + name + ".tar").c_str(), std::ios::binary);
+    m_index.open((m_output_dir + name + ".idx").c_str());
+    m_offset = 0;
+    m_shard++;
+  }
+
+  m_index << key << " " << m_offset + TAR_BLOCK << " " << image.size() << " " << ((label_ext.compare("cls")==0) ? label : label_ext) << "\n";
+  this->writeMember(key + ".png", reinterpret_cast<const char*>(image.data()), image.size());
+  this->writeMember(key + "." + label_ext, label.data(), label.size());
+  return true;
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method: a tar archive ends with two empty blocks.
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+void
+ShardWriter::close
+  ()
+{
+  if (!m_tar.is_open())
+    return;
+
+  char zeros[2*TAR_BLOCK];
+  memset(zeros, 0, sizeof(zeros));
+  m_tar.write(zeros, sizeof(zeros));
+  m_tar.close();
+  m_index.close();
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method: POSIX ustar header, long names use the prefix field.
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats: 'write' checks that the name can be split.
+//
+// -----------------------------------------------------------------------------
+void
+ShardWriter::writeMember
+  (
+  const std::string &member,
+  const char *data,
+  const size_t size
+  )
+{
+  std::string prefix, name;
+  splitTarName(member, prefix, name);
+
+  char header[TAR_BLOCK];
+  memset(header, 0, TAR_BLOCK);
+  memcpy(header, name.data(), name.size());
+  sprintf(header+100, "%07o", 0644);
+  sprintf(header+108, "%07o", 0);
+  sprintf(header+116, "%07o", 0);
+  sprintf(header+124, "%011lo", static_cast<unsigned long>(size));
+  sprintf(header+136, "%011lo", 0UL);
+  header[156] = '0';
+  memcpy(header+257, "ustar", 6);
+  memcpy(header+263, "00", 2);
+  memcpy(header+345, prefix.data(), prefix.size());
+
+  // Checksum is computed with its own field filled with spaces
+  memset(header+148, ' ', 8);
+  unsigned checksum = 0;
+  for (size_t i=0; i < TAR_BLOCK; i++)
+    checksum += static_cast<unsigned char>(header[i]);
+  sprintf(header+148, "%06o", checksum);
+  header[155] = ' ';
+
+  m_tar.write(header, TAR_BLOCK);
+  m_tar.write(data, size);
+  size_t padding = (TAR_BLOCK - size % TAR_BLOCK) % TAR_BLOCK;
+  char zeros[TAR_BLOCK];
+  memset(zeros, 0, padding);
+  m_tar.write(zeros, padding);
+  m_offset += TAR_BLOCK + size + padding;
+}
+
+} // close namespace urjc
@@ -0,0 +1,208 @@
+/** ****************************************************************************
+ *  @file    Statistics.cpp
+ *  @brief   Online statistics of the generated images of each class.
+ *  @author  Roberto Valle Fernandez.
+ *  @date    2012/01
+ *  @copyright All rights reserved.
+ *  Escuela Tecnica Superior de Ingenieria Informatica (Computer Science School)
+ *  Universidad Rey Juan Carlos (Spain)
+ ******************************************************************************/
+
+// ----------------------- INCLUDES --------------------------------------------
+#include <Statistics.hpp>
+#include <Constants.hpp>
+#include <trace.hpp>
+#include <cmath>
+#include <fstream>
+#include <algorithm>
+
+namespace urjc {
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method: Welford update.
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+void
+Moments::add
+  (
+  const double value
+  )
+{
+  min = (count > 0) ? std::min(min, value) : value;
+  max = (count > 0) ? std::max(max, value) : value;
+  count++;
+  double delta = value - mean;
+  mean += delta / count;
+  m2 += delta * (value - mean);
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method:
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+void
+Moments::merge
+  (
+  const Moments &other
+  )
+{
+  if (other.count == 0)
+    return;
+  if (count == 0)
+  {
+    *this = other;
+    return;
+  }
+
+  double total = static_cast<double>(count + other.count);
+  double delta = other.mean - mean;
+  mean += delta * other.count / total;
+  m2 += other.m2 + delta * delta * count * other.count / total;
+  count += other.count;
+  min = std::min(min, other.min);
+  max = std::max(max, other.max);
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method: the moments of the pixels of an image are computed in a
+// single pass and merged as a block. Ink pixels are darker than the
+// threshold, characters are black over a white background.
+// Inputs: 8 bits gray scale image
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+void
+ClassStatistics::add
+  (
+  const cv::Mat &img
+  )
+{
+  uint64_t sum = 0, sum2 = 0, ink_pixels = 0;
+  unsigned low = 255, high = 0;
+  for (int row=0; row < img.rows; row++)
+  {
+    const uchar *values = img.ptr<uchar>(row);
+    for (int col=0; col < img.cols; col++)
+    {
+      unsigned value = values[col];
+      sum += value;
+      sum2 += value*value;
+      ink_pixels += (value < Constants::INK_THRESHOLD) ? 1 : 0;
+      low = std::min(low, value);
+      high = std::max(high, value);
+    }
+  }
+
+  const uint64_t total = static_cast<uint64_t>(img.rows) * img.cols;
+  if (total > 0)
+  {
+    Moments block;
+    block.count = total;
+    block.mean = static_cast<double>(sum) / total;
+    block.m2 = static_cast<double>(sum2) - block.mean * static_cast<double>(sum);
+    block.min = low;
+    block.max = high;
+    pixels.merge(block);
+  }
+  width.add(img.cols);
+  height.add(img.rows);
+  ink.add((total > 0) ? static_cast<double>(ink_pixels) / total : 0.0);
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method:
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+void
+ClassStatistics::merge
+  (
+  const ClassStatistics &other
+  )
+{
+  pixels.merge(other.pixels);
+  width.merge(other.width);
+  height.merge(other.height);
+  ink.merge(other.ink);
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method:
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats: a worker without accumulators takes the classes
+// of the other one.
+//
+// -----------------------------------------------------------------------------
+void
+Statistics::merge
+  (
+  const Statistics &other
+  )
+{
+  if (m_classes.empty())
+    m_classes.resize(other.m_classes.size());
+  for (unsigned i=0; i < m_classes.size() && i < other.m_classes.size(); i++)
+    m_classes[i].merge(other.m_classes[i]);
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method: one row per class with the number of images, the mean
+// and standard deviation of the pixels, the size ranges and the ink fraction.
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+bool
+Statistics::save
+  (
+  const std::string &filename,
+  const std::vector<std::string> &names
+  ) const
+{
+  std::ofstream ofs(filename.c_str());
+  if (!ofs.is_open())
+  {
+    ERROR("Error. File " << filename << " can't be opened");
+    return false;
+  }
+
+  ofs << "# class images pixel_mean pixel_std width_mean width_min width_max height_mean height_min height_max ink_mean ink_std\n";
+  ClassStatistics all;
+  for (unsigned i=0; i <= m_classes.size(); i++)
+  {
+    const ClassStatistics &stats = (i < m_classes.size()) ? m_classes[i] : all;
+    if (i < m_classes.size())
+      all.merge(stats);
+    ofs << ((i < m_classes.size()) ? names[i] : std::string("all")) << " " << stats.width.count << " "
+        << stats.pixels.mean << " " << sqrt(stats.pixels.variance()) << " "
+        << stats.width.mean << " " << stats.width.min << " " << stats.width.max << " "
+        << stats.height.mean << " " << stats.height.min << " " << stats.height.max << " "
+        << stats.ink.mean << " " << sqrt(stats.ink.variance()) << "\n";
+  }
+  return true;
+}
+
+} // close namespace urjc
@@ -0,0 +1,152 @@
+/** ****************************************************************************
+ *  @file    Topology.cpp
+ *  @brief   Memory nodes of the machine and thread affinity.
+ *  @author  Roberto Valle Fernandez.
+ *  @date    2012/01
+ *  @copyright All rights reserved.
+ *  Escuela Tecnica Superior de Ingenieria Informatica (Computer Science School)
+ *  Universidad Rey Juan Carlos (Spain)
+ ******************************************************************************/
+
+// ----------------------- INCLUDES --------------------------------------------
+#include <Topology.hpp>
+#include <trace.hpp>
+
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+#include <thread>
+#include <pthread.h>
+#include <sched.h>
+
+namespace urjc {
+
+const char NODES_DIR[] = "/sys/devices/system/node/";
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method: nodes are probed until the first missing directory.
+// Processors outside the affinity of the process (taskset, cgroups) are
+// discarded.
+// Inputs:
+// Outputs:
+// Dependencies: Linux sysfs.
+// Restrictions and Caveats: without sysfs every allowed processor belongs to
+// a single node.
+//
+// -----------------------------------------------------------------------------
+Topology::Topology
+  ()
+{
+  cpu_set_t allowed;
+  CPU_ZERO(&allowed);
+  if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+    for (unsigned cpu=0; cpu < std::thread::hardware_concurrency(); cpu++)
+      CPU_SET(cpu, &allowed);
+
+  for (unsigned node=0; ; node++)
+  {
+    std::ostringstream filename;
+    filename << NODES_DIR << "node" << node << "/cpulist";
+    std::ifstream ifs(filename.str().c_str());
+    if (!ifs.is_open())
+      break;
+    std::string list;
+    std::getline(ifs, list);
+
+    std::vector<unsigned> cpus, node_cpus;
+    parseCpuList(list, cpus);
+    for (unsigned i=0; i < cpus.size(); i++)
+      if ((cpus[i] < CPU_SETSIZE) && CPU_ISSET(cpus[i], &allowed))
+        node_cpus.push_back(cpus[i]);
+    if (!node_cpus.empty())
+      m_cpus.push_back(node_cpus);
+  }
+
+  if (m_cpus.empty())
+  {
+    m_cpus.resize(1);
+    for (unsigned cpu=0; cpu < CPU_SETSIZE; cpu++)
+      if (CPU_ISSET(cpu, &allowed))
+        m_cpus[0].push_back(cpu);
+  }
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method: consecutive workers of a node take consecutive
+// processors, wrapping around if there are more workers than processors.
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+unsigned
+Topology::workerCpu
+  (
+  const unsigned t
+  ) const
+{
+  const std::vector<unsigned> &cpus = m_cpus[this->workerNode(t)];
+  return cpus[(t / m_cpus.size()) % cpus.size()];
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method:
+// Inputs:
+// Outputs:
+// Dependencies: pthread_setaffinity_np.
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+bool
+Topology::pinThread
+  (
+  const std::vector<unsigned> &cpus
+  )
+{
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (unsigned i=0; i < cpus.size(); i++)
+    CPU_SET(cpus[i], &set);
+  if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0)
+  {
+    ERROR("Error. Unable to set the affinity of a worker");
+    return false;
+  }
+  return true;
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method:
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+void
+parseCpuList
+  (
+  const std::string &list,
+  std::vector<unsigned> &cpus
+  )
+{
+  std::istringstream iss(list);
+  std::string range;
+  while (std::getline(iss, range, ','))
+  {
+    if (range.empty())
+      continue;
+    size_t dash = range.find('-');
+    unsigned first = atoi(range.substr(0, dash).c_str());
+    unsigned last = (dash == std::string::npos) ? first : atoi(range.substr(dash+1).c_str());
+    for (unsigned cpu=first; cpu <= last; cpu++)
+      cpus.push_back(cpu);
+  }
+}
+
+} // close namespace urjc
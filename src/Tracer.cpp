@@ -0,0 +1,232 @@
+/** ****************************************************************************
+ *  @file    Tracer.cpp
+ *  @brief   Timeline of the pipeline in per-thread ring buffers.
+ *  @author  Roberto Valle Fernandez.
+ *  @date    2012/01
+ *  @copyright All rights reserved.
+ *  Escuela Tecnica Superior de Ingenieria Informatica (Computer Science School)
+ *  Universidad Rey Juan Carlos (Spain)
+ ******************************************************************************/
+
+// ----------------------- INCLUDES --------------------------------------------
+#include <Tracer.hpp>
+#include <trace.hpp>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <algorithm>
+
+namespace urjc {
+
+// Events kept by each thread
+const unsigned TRACE_CAPACITY = 1 << 16;
+
+/**
+ * @brief Scope of a thread with its start and duration in nanoseconds.
+ */
+struct TraceEvent
+{
+  const char *name;
+  uint32_t id;
+  uint64_t start, duration;
+};
+
+/**
+ * @brief Ring buffer of a thread. Only the owner writes it, the counter is
+ * published after each event so a reader sees complete events.
+ */
+struct TraceBuffer
+{
+  TraceBuffer(unsigned t) : tid(t), events(TRACE_CAPACITY), count(0) {};
+  unsigned tid;
+  std::vector<TraceEvent> events;
+  std::atomic<uint64_t> count;
+};
+
+std::atomic<bool> g_tracing(false);
+std::mutex g_trace_mutex;
+std::vector<TraceBuffer*> g_buffers, g_free_buffers;
+
+/**
+ * @brief Returns the buffer of a thread to the pool when it exits, so the
+ * short lived workers of each batch share a few timeline rows.
+ */
+struct TraceHolder
+{
+  TraceHolder() : buffer(NULL) {};
+  ~TraceHolder()
+  {
+    if (buffer == NULL)
+      return;
+    std::lock_guard<std::mutex> lock(g_trace_mutex);
+    g_free_buffers.push_back(buffer);
+  };
+  TraceBuffer *buffer;
+};
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method:
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+static uint64_t
+traceClock
+  ()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method: the lock is only taken by the first event of a thread.
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+static TraceBuffer*
+threadBuffer
+  ()
+{
+  static thread_local TraceHolder holder;
+  if (holder.buffer == NULL)
+  {
+    std::lock_guard<std::mutex> lock(g_trace_mutex);
+    if (g_free_buffers.empty())
+    {
+      holder.buffer = new TraceBuffer(g_buffers.size());
+      g_buffers.push_back(holder.buffer);
+    }
+    else
+    {
+      holder.buffer = g_free_buffers.back();
+      g_free_buffers.pop_back();
+    }
+  }
+  return holder.buffer;
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method:
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+void
+enableTracing
+  ()
+{
+  g_tracing = true;
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method: complete events ('X') with microseconds since the
+// first recorded event. Threads whose buffer wrapped only keep their last
+// 'TRACE_CAPACITY' events.
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+bool
+saveTrace
+  (
+  const std::string &filename
+  )
+{
+  std::ofstream ofs(filename.c_str());
+  if (!ofs.is_open())
+  {
+    ERROR("Error. Unable to write " << filename);
+    return false;
+  }
+
+  std::lock_guard<std::mutex> lock(g_trace_mutex);
+  uint64_t origin = UINT64_MAX;
+  for (unsigned b=0; b < g_buffers.size(); b++)
+  {
+    const uint64_t count = g_buffers[b]->count.load(std::memory_order_acquire);
+    const uint64_t first = (count > TRACE_CAPACITY) ? count - TRACE_CAPACITY : 0;
+    for (uint64_t n=first; n < count; n++)
+      origin = std::min(origin, g_buffers[b]->events[n % TRACE_CAPACITY].start);
+  }
+
+  ofs << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[" << std::endl;
+  bool comma = false;
+  for (unsigned b=0; b < g_buffers.size(); b++)
+  {
+    const TraceBuffer &buffer = *g_buffers[b];
+    ofs << (comma ? ",\n" : "") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer.tid << ",\"args\":{\"name\":\"" << "thread " << buffer.tid << "\"}}";
+    comma = true;
+    const uint64_t count = buffer.count.load(std::memory_order_acquire);
+    const uint64_t first = (count > TRACE_CAPACITY) ? count - TRACE_CAPACITY : 0;
+    for (uint64_t n=first; n < count; n++)
+    {
+      const TraceEvent &event = buffer.events[n % TRACE_CAPACITY];
+      ofs << ",\n{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer.tid;
+      ofs << ",\"ts\":" << (event.start - origin) / 1000.0 << ",\"dur\":" << event.duration / 1000.0;
+      ofs << ",\"args\":{\"id\":" << event.id << "}}";
+    }
+  }
+  ofs << std::endl << "]}" << std::endl;
+  return true;
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method:
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats: the name must outlive the trace.
+//
+// -----------------------------------------------------------------------------
+TraceScope::TraceScope
+  (
+  const char *name,
+  const uint32_t id
+  )
+{
+  m_name = name;
+  m_id = id;
+  m_active = g_tracing.load(std::memory_order_relaxed);
+  m_start = m_active ? traceClock() : 0;
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method:
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+TraceScope::~TraceScope
+  ()
+{
+  if (!m_active)
+    return;
+  TraceBuffer *buffer = threadBuffer();
+  const uint64_t count = buffer->count.load(std::memory_order_relaxed);
+  TraceEvent &event = buffer->events[count % TRACE_CAPACITY];
+  event.name = m_name;
+  event.id = m_id;
+  event.start = m_start;
+  event.duration = traceClock() - m_start;
+  buffer->count.store(count+1, std::memory_order_release);
+}
+
+} // close namespace urjc
@@ -0,0 +1,121 @@
+/** ****************************************************************************
+ *  @file    WorkerPool.cpp
+ *  @brief   Threads started once and reused for every batch of work.
+ *  @author  Roberto Valle Fernandez.
+ *  @date    2012/01
+ *  @copyright All rights reserved.
+ *  Escuela Tecnica Superior de Ingenieria Informatica (Computer Science School)
+ *  Universidad Rey Juan Carlos (Spain)
+ ******************************************************************************/
+
+// ----------------------- INCLUDES --------------------------------------------
+#include <WorkerPool.hpp>
+#include <algorithm>
+
+namespace urjc {
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method:
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+WorkerPool::WorkerPool
+  (
+  const unsigned num_threads
+  )
+{
+  m_job = NULL;
+  m_generation = 0;
+  m_running = 0;
+  m_stop = false;
+  for (unsigned t=0; t < std::max(num_threads, 1u); t++)
+    m_workers.push_back(std::thread(&WorkerPool::work, this, t));
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method:
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+WorkerPool::~WorkerPool
+  ()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stop = true;
+    m_condition.notify_all();
+  }
+  for (unsigned t=0; t < m_workers.size(); t++)
+    m_workers[t].join();
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method:
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats: not reentrant, a single thread submits the jobs.
+//
+// -----------------------------------------------------------------------------
+void
+WorkerPool::run
+  (
+  const std::function<void (unsigned)> &job
+  )
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_job = &job;
+  m_running = m_workers.size();
+  m_generation++;
+  m_condition.notify_all();
+  m_condition.wait(lock, [this]() { return m_running == 0; });
+  m_job = NULL;
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method: each thread waits for a new generation, runs the job
+// outside the lock and the last one to finish wakes the caller.
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+void
+WorkerPool::work
+  (
+  const unsigned t
+  )
+{
+  unsigned generation = 0;
+  while (true)
+  {
+    const std::function<void (unsigned)> *job;
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_condition.wait(lock, [&]() { return m_stop || (m_generation != generation); });
+      if (m_stop)
+        return;
+      generation = m_generation;
+      job = m_job;
+    }
+    (*job)(t);
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if (--m_running == 0)
+        m_condition.notify_all();
+    }
+  }
+}
+
+} // close namespace urjc
@@ -0,0 +1,103 @@
+/** ****************************************************************************
+ *  @file    bench_affine.cpp
+ *  @brief   Compare the separable scale and translation with cv::warpAffine.
+ *  @author  Roberto Valle Fernandez.
+ *  @date    2012/01
+ *  @copyright All rights reserved.
+ *  Escuela Tecnica Superior de Ingenieria Informatica (Computer Science School)
+ *  Universidad Rey Juan Carlos (Spain)
+ ******************************************************************************/
+
+// ----------------------- INCLUDES --------------------------------------------
+#include <operations.hpp>
+#include <trace.hpp>
+
+#include <vector>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <opencv/cv.h>
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method: the general warp as 'affineTransform' called it.
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+void
+generalWarp
+  (
+  const cv::Mat &src,
+  cv::Mat &dst,
+  const float scale,
+  const float tx,
+  const float ty
+  )
+{
+  float angle = 0.0;
+  cv::Matx23f M( scale*cos(angle), sin(angle), tx,
+                -sin(angle), scale*cos(angle), ty );
+  cv::Mat output;
+  cv::warpAffine(src, output, M, output.size());
+  dst = output.clone();
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method: glyph sized images with random pixels and the random
+// parameters of 'affineTransform', both paths get the same inputs.
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+int
+main
+  (
+  int argc,
+  char **argv
+  )
+{
+  const unsigned num_images = (argc > 1) ? atoi(argv[1]) : 20000;
+  const int size = (argc > 2) ? atoi(argv[2]) : 56;
+  cv::RNG rng(12345);
+  std::vector<cv::Mat> images(num_images);
+  std::vector<float> scales(num_images), txs(num_images), tys(num_images);
+  for (unsigned i=0; i < num_images; i++)
+  {
+    images[i].create(size + rng.uniform(-8, 8), size + rng.uniform(-8, 8), CV_8UC1);
+    rng.fill(images[i], cv::RNG::UNIFORM, cv::Scalar(0), cv::Scalar(256));
+    scales[i] = rng.uniform(0.9f, 0.95f);
+    txs[i]    = rng.uniform(-1.0f, 2.0f);
+    tys[i]    = rng.uniform(-1.0f, 2.0f);
+  }
+
+  cv::Mat general, separable;
+  double general_ticks = 0.0, separable_ticks = 0.0;
+  unsigned mismatches = 0;
+  for (unsigned i=0; i < num_images; i++)
+  {
+    double ticks = static_cast<double>(cv::getTickCount());
+    generalWarp(images[i], general, scales[i], txs[i], tys[i]);
+    general_ticks += static_cast<double>(cv::getTickCount()) - ticks;
+
+    ticks = static_cast<double>(cv::getTickCount());
+    urjc::scaleTranslate(images[i], separable, scales[i], txs[i], tys[i]);
+    separable_ticks += static_cast<double>(cv::getTickCount()) - ticks;
+
+    bool same = (general.size() == separable.size());
+    for (int y=0; same && (y < general.rows); y++)
+      same = (memcmp(general.ptr<uchar>(y), separable.ptr<uchar>(y), general.cols) == 0);
+    mismatches += !same;
+  }
+
+  const double scale = 1e6 / (cv::getTickFrequency() * num_images);
+  PRINT("warpAffine: " << general_ticks*scale << " us/image");
+  PRINT("Separable: " << separable_ticks*scale << " us/image (" << general_ticks/separable_ticks << "x)");
+  PRINT(mismatches << " of " << num_images << " images differ");
+  return (mismatches == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
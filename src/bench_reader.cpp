@@ -0,0 +1,125 @@
+/** ****************************************************************************
+ *  @file    bench_reader.cpp
+ *  @brief   Compare the dataset reader with reading one image at a time.
+ *  @author  Roberto Valle Fernandez.
+ *  @date    2012/01
+ *  @copyright All rights reserved.
+ *  Escuela Tecnica Superior de Ingenieria Informatica (Computer Science School)
+ *  Universidad Rey Juan Carlos (Spain)
+ ******************************************************************************/
+
+// ----------------------- INCLUDES --------------------------------------------
+#include <DatasetReader.hpp>
+#include <trace.hpp>
+
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <thread>
+#include <opencv/cv.h>
+#include <opencv/highgui.h>
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method: what a loader without readahead does, each image is
+// read and decoded in the listing order by a single thread.
+// Inputs:
+// Outputs: images per second
+// Dependencies:
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+double
+rawWalk
+  (
+  const urjc::DatasetReader &reader
+  )
+{
+  const std::vector<urjc::DatasetEntry> &entries = reader.entries();
+  std::vector<uchar> buffer;
+  double ticks = static_cast<double>(cv::getTickCount());
+  for (unsigned i=0; i < entries.size(); i++)
+  {
+    cv::Mat img;
+    if (entries[i].shard < 0)
+      img = cv::imread(entries[i].path, CV_LOAD_IMAGE_GRAYSCALE);
+    else if (reader.readEntry(entries[i], buffer))
+      img = cv::imdecode(cv::Mat(buffer), CV_LOAD_IMAGE_GRAYSCALE);
+  }
+  ticks = static_cast<double>(cv::getTickCount()) - ticks;
+  return entries.size() / (ticks / cv::getTickFrequency());
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method:
+// Inputs:
+// Outputs: images per second over every epoch
+// Dependencies:
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+double
+readEpochs
+  (
+  urjc::DatasetReader &reader,
+  const unsigned num_epochs
+  )
+{
+  size_t num_images = 0;
+  double ticks = static_cast<double>(cv::getTickCount());
+  for (unsigned epoch=0; epoch < num_epochs; epoch++)
+  {
+    reader.startEpoch();
+    const urjc::Batch *batch;
+    while ((batch = reader.next()) != NULL)
+    {
+      num_images += batch->size;
+      reader.release(batch);
+    }
+  }
+  ticks = static_cast<double>(cv::getTickCount()) - ticks;
+  return num_images / (ticks / cv::getTickFrequency());
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method:
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+int
+main
+  (
+  int argc,
+  char **argv
+  )
+{
+  if (argc < 2)
+  {
+    PRINT("Usage: " << argv[0] << " <dataset directory> [threads] [batch size] [shuffle size] [epochs]");
+    return EXIT_FAILURE;
+  }
+  unsigned num_threads = (argc > 2) ? atoi(argv[2]) : std::max(std::thread::hardware_concurrency(), 1u);
+  unsigned batch_size = (argc > 3) ? atoi(argv[3]) : 256;
+  unsigned shuffle_size = (argc > 4) ? atoi(argv[4]) : 4096;
+  unsigned num_epochs = (argc > 5) ? atoi(argv[5]) : 2;
+
+  urjc::DatasetReader reader(argv[1], num_threads, batch_size, shuffle_size, 0);
+  if (reader.size() == 0)
+  {
+    ERROR("Error. No images found in " << argv[1]);
+    return EXIT_FAILURE;
+  }
+  PRINT("Found " << reader.size() << " images of " << reader.labels().size() << " classes");
+
+  // An untimed walk first loads the files in the page cache, so both timed
+  // runs read from a warm cache and only the decoding and threading differ
+  rawWalk(reader);
+  PRINT("Raw walk: " << rawWalk(reader) << " images/s with 1 thread");
+  PRINT("Reader: " << readEpochs(reader, num_epochs) << " images/s with " << num_threads << " threads, batches of " << batch_size << " and a shuffle buffer of " << shuffle_size);
+  return EXIT_SUCCESS;
+}
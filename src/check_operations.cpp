@@ -0,0 +1,100 @@
+/** ****************************************************************************
+ *  @file    check_operations.cpp
+ *  @brief   Compare the fused operations with the OpenCV calls they replace.
+ *  @author  Roberto Valle Fernandez.
+ *  @date    2012/01
+ *  @copyright All rights reserved.
+ *  Escuela Tecnica Superior de Ingenieria Informatica (Computer Science School)
+ *  Universidad Rey Juan Carlos (Spain)
+ ******************************************************************************/
+
+// ----------------------- INCLUDES --------------------------------------------
+#include <operations.hpp>
+#include <trace.hpp>
+
+#include <cstdlib>
+#include <algorithm>
+#include <opencv/cv.h>
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method: the chain 'anisotropicFilter' used before
+// 'anisotropicEqualize'.
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+void
+anisotropicChain
+  (
+  const cv::Mat &img,
+  const cv::Mat &smoothed,
+  cv::Mat &dst
+  )
+{
+  cv::Mat input, denominator, output;
+  cv::add(smoothed, cv::Scalar(0.000001), denominator);
+  img.convertTo(input, CV_32FC1);
+  cv::divide(input, denominator, output);
+  output.convertTo(output, CV_8UC1);
+  cv::equalizeHist(output, dst);
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method: random images of glyph sizes, smoothed like
+// 'anisotropicFilter' does, half of them blurred so the ratios are close to
+// one. A divide through a reciprocal may round a ratio to the other gray
+// level, which moves the pixels of that level after the equalization, so a
+// pixel may differ by one level and at most 0.1% of them by more.
+// Inputs:
+// Outputs: failure if an image is out of the tolerance
+// Dependencies:
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+int
+main
+  (
+  int argc,
+  char **argv
+  )
+{
+  const unsigned num_images = (argc > 1) ? atoi(argv[1]) : 2000;
+  cv::RNG rng(12345);
+  float std = (static_cast<float>(11)-1.0)/(7.0*2.0);
+  cv::Mat conv_mask = urjc::createGaussianMask(11, std);
+
+  unsigned failures = 0, exact = 0;
+  size_t num_pixels = 0, num_far = 0;
+  int max_difference = 0;
+  for (unsigned i=0; i < num_images; i++)
+  {
+    cv::Mat img(rng.uniform(8, 90), rng.uniform(8, 90), CV_8UC1);
+    rng.fill(img, cv::RNG::UNIFORM, cv::Scalar(0), cv::Scalar(256));
+    if (i % 2 == 0)
+      cv::GaussianBlur(img, img, cv::Size(5, 5), 2.0);
+    cv::Mat smoothed = cv::Mat(img.rows, img.cols, img.type());
+    urjc::anisotropicSmooth(img, smoothed, conv_mask);
+
+    cv::Mat fused, chain, difference;
+    urjc::anisotropicEqualize(img, smoothed, fused);
+    anisotropicChain(img, smoothed, chain);
+    cv::absdiff(fused, chain, difference);
+    double max_value;
+    cv::minMaxLoc(difference, NULL, &max_value);
+    size_t far = cv::countNonZero(difference > 1);
+    num_pixels += img.total();
+    num_far += far;
+    max_difference = std::max(max_difference, static_cast<int>(max_value));
+    exact += (max_value == 0);
+    failures += (far*1000 > img.total());
+  }
+
+  PRINT(exact << " of " << num_images << " images are equal, maximum difference " << max_difference);
+  PRINT(num_far << " of " << num_pixels << " pixels differ by more than one level");
+  PRINT(failures << " images out of the tolerance");
+  return (failures == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
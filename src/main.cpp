@@ -11,12 +11,22 @@
 // ----------------------- INCLUDES --------------------------------------------
 #include <MyFreetype.hpp>
 #include <Constants.hpp>
+#include <Golden.hpp>
+#include <Budget.hpp>
+#include <FontCatalog.hpp>
+#include <Calibration.hpp>
+#include <Profiler.hpp>
+#include <Tracer.hpp>
 #include <trace.hpp>
 
 #include <string>
 #include <vector>
+#include <sstream>
+#include <cstdlib>
+#include <climits>
 #include <boost/filesystem.hpp>
 #include <opencv/cv.h>
+#include <opencv/highgui.h>
 
 namespace fs = boost::filesystem;
 
@@ -69,6 +79,121 @@ loadTrueTypeForWildText
   characters.insert(characters.end(), LOWER, LOWER + sizeof(LOWER)/sizeof(LOWER[0]));
 }
 
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method:
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats: values must be whole positive numbers.
+//
+// -----------------------------------------------------------------------------
+void
+parseCharacterSizes
+  (
+  const std::string &arg,
+  std::vector<urjc::CharSize> &sizes
+  )
+{
+  // Comma separated list of 'size' or 'size:dpi' values
+  std::stringstream ss(arg);
+  std::string item;
+  while (std::getline(ss, item, ','))
+  {
+    size_t pos = item.find(':');
+    std::string size_str = item.substr(0, pos);
+    std::string dpi_str = (pos == std::string::npos) ? std::to_string(urjc::Constants::CHAR_DPI) : item.substr(pos+1);
+    char *size_end, *dpi_end;
+    long size = strtol(size_str.c_str(), &size_end, 10);
+    long dpi = strtol(dpi_str.c_str(), &dpi_end, 10);
+    if ((size > 0) && (dpi > 0) && (size <= USHRT_MAX) && (dpi <= USHRT_MAX) && !size_str.empty() && !dpi_str.empty() && (*size_end == '\0') && (*dpi_end == '\0'))
+      sizes.push_back(urjc::CharSize(size, dpi));
+    else
+      ERROR("Error. Size " << item << " is not valid");
+  }
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method:
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+void
+printMetrics
+  (
+  const urjc::Metrics &metrics
+  )
+{
+  PRINT("Loaded " << metrics.faces << " faces and " << metrics.outlines << " outlines");
+  PRINT("Rendered " << metrics.bitmaps << " bitmaps");
+  PRINT("Generated " << metrics.samples << " samples (" << metrics.resampled << " resampled, " << metrics.dropped << " dropped)");
+  PRINT("Saved " << metrics.bytes/(1024*1024) << " MB");
+  for (unsigned n=0; n < metrics.nodes.size(); n++)
+  {
+    const urjc::NodeMetrics &node = metrics.nodes[n];
+    PRINT("Node " << n << ": " << node.samples << " samples at " << ((node.transform_seconds > 0) ? node.samples/node.transform_seconds : 0.0) << " samples/s (" << node.stolen << " classes stolen), " << node.encoded << " encoded at " << ((node.encode_seconds > 0) ? node.encoded/node.encode_seconds : 0.0) << " images/s");
+  }
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method:
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+double
+imagesPerSecond
+  (
+  const size_t num_images,
+  const double ticks
+  )
+{
+  return (ticks > 0) ? num_images/(ticks/cv::getTickFrequency()) : 0.0;
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method: transform the rendered images and encode them in memory
+// storing the checksums and throughput of each stage.
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+void
+measureGoldenOutput
+  (
+  urjc::MyFreetype &freetype,
+  urjc::Golden &golden
+  )
+{
+  double ticks = static_cast<double>(cv::getTickCount());
+  freetype.transformImages();
+  ticks = static_cast<double>(cv::getTickCount()) - ticks;
+  golden.addChecksums("sample", freetype.getImages());
+  golden.addRate("transform", imagesPerSecond(freetype.getMetrics().samples, ticks));
+
+  std::vector<int> compression_params;
+  compression_params.push_back(CV_IMWRITE_PNG_COMPRESSION);
+  compression_params.push_back(freetype.getCompression());
+  std::vector<uchar> buffer;
+  ticks = static_cast<double>(cv::getTickCount());
+  const std::vector< std::vector<cv::Mat> > &images = freetype.getImages();
+  for (unsigned i=0; i < images.size(); i++)
+    for (unsigned j=0; j < images[i].size(); j++)
+      cv::imencode(".png", images[i][j], buffer, compression_params);
+  ticks = static_cast<double>(cv::getTickCount()) - ticks;
+  golden.addRate("encode", imagesPerSecond(freetype.getMetrics().samples, ticks));
+}
+
 // -----------------------------------------------------------------------------
 //
 // Purpose and Method:
@@ -87,55 +212,222 @@ main
 {
   double ticks = static_cast<double>(cv::getTickCount());
   fs::path fonts_path(urjc::Constants::FONTS_DIR);
-  if (!fs::exists(fonts_path) || !fs::is_directory(fonts_path))
+
+  // Generate the synthetic images using Freetype library
+  urjc::MyFreetype freetype;
+  int option = 0;
+  std::string golden_file, font_file;
+  bool record = false;
+  bool calibrate = false;
+  std::string profile_file, trace_file;
+  size_t memory_limit = static_cast<size_t>(urjc::Constants::MEMORY_LIMIT)*1024*1024;
+  double margin = urjc::Constants::GOLDEN_MARGIN;
+  size_t max_samples = 0;
+  double max_minutes = 0.0;
+  for (int i=1; i < argc; i++)
+  {
+    std::string arg(argv[i]);
+    if ((arg.compare("--option")==0) && (i+1 < argc))
+      option = atoi(argv[++i]);
+    else if ((arg.compare("--font")==0) && (i+1 < argc))
+      font_file = argv[++i];
+    else if ((arg.compare("--budget")==0) && (i+1 < argc))
+    {
+      urjc::Budget budget;
+      if (!budget.load(argv[++i]))
+        return EXIT_FAILURE;
+      freetype.setBudget(budget);
+    }
+    else if ((arg.compare("--threads")==0) && (i+1 < argc))
+    {
+      unsigned threads = atoi(argv[++i]);
+      freetype.setThreads(threads, threads);
+    }
+    else if ((arg.compare("--batch")==0) && (i+1 < argc))
+      freetype.setBatchSize(atoi(argv[++i]));
+    else if ((arg.compare("--compression")==0) && (i+1 < argc))
+      freetype.setCompression(atoi(argv[++i]));
+    else if ((arg.compare("--profile")==0) && (i+1 < argc))
+      profile_file = argv[++i];
+    else if ((arg.compare("--trace")==0) && (i+1 < argc))
+      trace_file = argv[++i];
+    else if (arg.compare("--calibrate")==0)
+      calibrate = true;
+    else if ((arg.compare("--memory")==0) && (i+1 < argc))
+      memory_limit = static_cast<size_t>(atoi(argv[++i]))*1024*1024;
+    else if (arg.compare("--sdf")==0)
+      freetype.setDistanceFields(true);
+    else if ((arg.compare("--supersample")==0) && (i+1 < argc))
+      freetype.setSupersampling(atoi(argv[++i]));
+    else if ((arg.compare("--max-samples")==0) && (i+1 < argc))
+      max_samples = strtoull(argv[++i], NULL, 10);
+    else if ((arg.compare("--max-minutes")==0) && (i+1 < argc))
+      max_minutes = atof(argv[++i]);
+    else if (arg.compare("--numa")==0)
+      freetype.setNumaAffinity(true);
+    else if ((arg.compare("--compact")==0) && (i+1 < argc))
+      freetype.setCompactGlyphs(atoi(argv[++i]));
+    else if (arg.compare("--degrade")==0)
+      freetype.setDegradation(true);
+    else if ((arg.compare("--dedup")==0) && (i+1 < argc))
+      freetype.setDeduplication(atoi(argv[++i]));
+    else if (arg.compare("--shuffle")==0)
+      freetype.setOutputShuffle(static_cast<size_t>(urjc::Constants::SHUFFLE_MEMORY)*1024*1024);
+    else if ((arg.compare("--shards")==0) && (i+1 < argc))
+      freetype.setOutputShards(static_cast<size_t>(atoi(argv[++i]))*1024*1024);
+    else if ((arg.compare("--sizes")==0) && (i+1 < argc))
+    {
+      std::vector<urjc::CharSize> sizes;
+      parseCharacterSizes(argv[++i], sizes);
+      if (!sizes.empty())
+        freetype.setCharacterSizes(sizes);
+    }
+    else if ((arg.compare("--lines")==0) && (i+1 < argc))
+      freetype.setTextLines(atoi(argv[++i]), urjc::Constants::LINE_LENGTH);
+    else if ((arg.compare("--seed")==0) && (i+1 < argc))
+      freetype.setSeed(strtoull(argv[++i], NULL, 10));
+    else if ((arg.compare("--golden")==0) && (i+1 < argc))
+      golden_file = argv[++i];
+    else if (arg.compare("--record")==0)
+      record = true;
+    else if ((arg.compare("--margin")==0) && (i+1 < argc))
+      margin = atof(argv[++i]);
+    else
+      ERROR("Error. Unknown argument " << arg);
+  }
+
+  // A single font file replaces the fonts directory
+  if (!font_file.empty())
+  {
+    if (!fs::is_regular_file(font_file))
+    {
+      ERROR("Error. Font " << font_file << " doesn't exist");
+      return EXIT_FAILURE;
+    }
+    fonts_path = fs::absolute(font_file).parent_path() / "/";
+    option = 3;
+  }
+  else if (!fs::exists(fonts_path) || !fs::is_directory(fonts_path))
   {
     ERROR("Error. Directory " << fonts_path << " doesn't exist");
     return EXIT_FAILURE;
   }
 
-  PRINT("Allowed options");
-  PRINT("  1) Use Spanish document identity OCR-B font");
-  PRINT("  2) Use all True Type fonts");
+  if (!profile_file.empty() && !urjc::enableProfiling())
+    return EXIT_FAILURE;
+  if (!trace_file.empty())
+    urjc::enableTracing();
 
-  int option;
-  std::cout << std::endl << "Enter the option: ";
-  std::cin >> option;
+  // The reference run fixes the seed
+  urjc::Golden golden, reference;
+  if (!golden_file.empty() && !record)
+  {
+    if (!reference.load(golden_file))
+      return EXIT_FAILURE;
+    freetype.setSeed(reference.getSeed());
+  }
+
+  if (option == 0)
+  {
+    PRINT("Allowed options");
+    PRINT("  1) Use Spanish document identity OCR-B font");
+    PRINT("  2) Use all True Type fonts");
+
+    std::cout << std::endl << "Enter the option: ";
+    std::cin >> option;
+  }
 
-  // Generate the synthetic images using Freetype library
-  urjc::MyFreetype freetype;
   std::vector<unsigned> characters;
   std::string filename;
-  fs::directory_iterator it1_end;
+  urjc::FontCatalog catalog;
+  std::vector<std::string> fonts;
   switch (option)
   {
     case 1:
       loadTrueTypeForDNIs(characters);
       freetype.setCharacters(characters);
-      PRINT("Open True Type font: Ocrb.ttf");
-      filename = fonts_path.string() + "Ocrb.ttf";
-      freetype.generateImagesFromTrueTypeFont(filename.c_str());
+      fonts.push_back("Ocrb.ttf");
       break;
     case 2:
       loadTrueTypeForWildText(characters);
       freetype.setCharacters(characters);
-      for (fs::directory_iterator it1(fonts_path) ; it1 != it1_end ; it1++)
-      {
-        PRINT("Open True Type font: " << it1->path().filename().string());
-        if (it1->path().extension().string().compare(".ttf")==0)
-          freetype.generateImagesFromTrueTypeFont(it1->path().c_str());
-        else
-          ERROR("Error. File " << it1->path() << " can't be opened");
-      }
+      // Only fonts with every character are opened
+      catalog.load(urjc::Constants::CATALOG_FILE);
+      catalog.refresh(fonts_path.string());
+      catalog.save(urjc::Constants::CATALOG_FILE);
+      catalog.select(characters, fonts);
+      break;
+    case 3:
+      loadTrueTypeForWildText(characters);
+      freetype.setCharacters(characters);
+      freetype.setCharacterMap(true);
+      fonts.push_back(fs::path(font_file).filename().string());
       break;
     default:
       break;
   }
 
-  // Apply random transformations and save images
-  TRACE("Transform images ...");
-  freetype.transformImages();
-  TRACE("Save images ...");
-  freetype.saveImages(urjc::Constants::CHARS_DIR);
+  // Tune the run on its first fonts before rendering all of them
+  if (calibrate && !fonts.empty())
+  {
+    urjc::Calibration calibration(fonts_path.string(), fonts);
+    calibration.run(freetype, memory_limit);
+    calibration.print();
+    calibration.apply(freetype);
+  }
+
+  double stage_ticks = static_cast<double>(cv::getTickCount());
+  for (unsigned i=0; i < fonts.size(); i++)
+  {
+    PRINT("Open True Type font: " << fonts[i]);
+    filename = fonts_path.string() + fonts[i];
+    freetype.generateImagesFromTrueTypeFont(filename.c_str());
+  }
+
+  if (!golden_file.empty())
+  {
+    stage_ticks = static_cast<double>(cv::getTickCount()) - stage_ticks;
+    golden.setSeed(freetype.getSeed());
+    std::vector< std::vector<cv::Mat> > base;
+    freetype.getBaseImages(base);
+    golden.addChecksums("base", base);
+    golden.addRate("render", imagesPerSecond(freetype.getMetrics().bitmaps, stage_ticks));
+    measureGoldenOutput(freetype, golden);
+    if (!profile_file.empty())
+      urjc::saveProfile(profile_file);
+    if (!trace_file.empty())
+      urjc::saveTrace(trace_file);
+    if (record)
+      return golden.save(golden_file) ? EXIT_SUCCESS : EXIT_FAILURE;
+    bool equal = golden.compare(reference, margin);
+    PRINT((equal ? "Output matches " : "Output differs from ") << golden_file);
+    return equal ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+
+  // Apply random transformations and save images, in parts within the
+  // remaining time of a budgeted run
+  if ((max_samples > 0) || (max_minutes > 0))
+  {
+    double remaining = max_minutes*60 - (static_cast<double>(cv::getTickCount()) - ticks)/cv::getTickFrequency();
+    if ((max_minutes > 0) && (remaining <= 0))
+    {
+      PRINT("No time left to transform images");
+    }
+    else if (!freetype.generateBudgeted(urjc::Constants::CHARS_DIR, max_samples, (max_minutes > 0) ? remaining : 0.0))
+      return EXIT_FAILURE;
+  }
+  else
+  {
+    TRACE("Transform images ...");
+    freetype.transformImages();
+    TRACE("Save images ...");
+    freetype.saveImages(urjc::Constants::CHARS_DIR);
+  }
+  printMetrics(freetype.getMetrics());
+  if (!profile_file.empty())
+    urjc::saveProfile(profile_file);
+  if (!trace_file.empty())
+    urjc::saveTrace(trace_file);
 
   ticks = static_cast<double>(cv::getTickCount() - ticks);
   PRINT("Elapsed time: " << (ticks/cv::getTickFrequency())*1000 << " ms");
@@ -10,7 +10,15 @@
 
 // ----------------------- INCLUDES --------------------------------------------
 #include <operations.hpp>
+#include <Profiler.hpp>
 #include <opencv/highgui.h>
+#include <vector>
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 namespace urjc {
 
@@ -27,21 +35,268 @@ void
 affineTransform
   (
   cv::RNG &rng,
-  cv::Mat &img
+  cv::Mat &img,
+  Augmentation &aug
   )
 {
+  ProfileScope scope("affine");
   float angle = 0.0; // rotate about origin
   float scale = rng.uniform(0.9f, 0.95f); // scale about origin
   float tx = rng.uniform(-1.0f, 2.0f); // translate
   float ty = rng.uniform(-1.0f, 2.0f); // translate
+  aug.scale = scale;
+  aug.tx = tx;
+  aug.ty = ty;
+
+  cv::Mat output;
+  if ((angle == 0.0f) && (img.type() == CV_8UC1))
+  {
+    scaleTranslate(img, output, scale, tx, ty);
+    img = output;
+    return;
+  }
 
   // 2x3 transformation matrix (2D rotation + 2D translation + scale)
   cv::Matx23f M( scale*cos(angle), sin(angle), tx,
                 -sin(angle), scale*cos(angle), ty );
-
-  cv::Mat output;
   cv::warpAffine(img, output, M, output.size());
-  img = output.clone();
+  img = output;
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method: 'cv::warpAffine' inverts the matrix in double precision
+// and maps each output pixel to fixed point source coordinates with
+// 'INTER_BITS' fractional bits. Without rotation the column only depends on x
+// and the row on y, so both are tabulated once. The bilinear weights
+// '(32-f)' and 'f' of each axis multiply to the 15 bits weights of OpenCV
+// divided by 32, so a horizontal pass to 16 bits followed by a vertical pass
+// rounded by 10 bits gives the same pixels (OpenCV saturates the weight 32768
+// of an exact position to 32767, which rounds to the same 8 bits value).
+// Samples outside the image have zero weight, which is the constant zero
+// border.
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats: relies on the fixed point path of OpenCV 2.x.
+//
+// -----------------------------------------------------------------------------
+void
+scaleTranslate
+  (
+  const cv::Mat &src,
+  cv::Mat &dst,
+  const float scale,
+  const float tx,
+  const float ty
+  )
+{
+  const int INTER_BITS = 5, INTER_SIZE = 1 << INTER_BITS;
+  const int AB_BITS = 10, AB_SCALE = 1 << AB_BITS;
+  const int ROUND_DELTA = AB_SCALE/INTER_SIZE/2;
+  dst.create(src.size(), CV_8UC1);
+  if (src.empty())
+    return;
+
+  // Inverse map as computed by cv::warpAffine
+  const double D = 1.0 / (static_cast<double>(scale)*scale);
+  const double a = scale*D;
+  const double bx = -a*tx, by = -a*ty;
+
+  // Source columns and interleaved weights of each output column
+  std::vector<int> cols0(dst.cols), cols1(dst.cols);
+  std::vector<short> col_weights(2*dst.cols);
+  const int X0 = cvRound(bx*AB_SCALE) + ROUND_DELTA;
+  for (int x=0; x < dst.cols; x++)
+  {
+    const int X = (X0 + cvRound(a*x*AB_SCALE)) >> (AB_BITS - INTER_BITS);
+    const int sx = X >> INTER_BITS, fx = X & (INTER_SIZE-1);
+    const bool in0 = (sx >= 0) && (sx < src.cols), in1 = (sx+1 >= 0) && (sx+1 < src.cols);
+    cols0[x] = in0 ? sx : 0;
+    cols1[x] = in1 ? sx+1 : 0;
+    col_weights[2*x] = in0 ? INTER_SIZE - fx : 0;
+    col_weights[2*x+1] = in1 ? fx : 0;
+  }
+
+  // Horizontal pass of every source row, at most 255*32 per pixel
+  cv::Mat horizontal(src.rows, dst.cols, CV_16SC1);
+  std::vector<short> pairs(2*dst.cols);
+  for (int row=0; row < src.rows; row++)
+  {
+    const uchar *src_row = src.ptr<uchar>(row);
+    short *h_row = horizontal.ptr<short>(row);
+    for (int x=0; x < dst.cols; x++)
+    {
+      pairs[2*x] = src_row[cols0[x]];
+      pairs[2*x+1] = src_row[cols1[x]];
+    }
+    int x = 0;
+#if defined(__SSE2__)
+    for (; x <= dst.cols-8; x += 8)
+    {
+      __m128i sum0 = _mm_madd_epi16(_mm_loadu_si128((const __m128i*)(&pairs[2*x])), _mm_loadu_si128((const __m128i*)(&col_weights[2*x])));
+      __m128i sum1 = _mm_madd_epi16(_mm_loadu_si128((const __m128i*)(&pairs[2*x+8])), _mm_loadu_si128((const __m128i*)(&col_weights[2*x+8])));
+      _mm_storeu_si128((__m128i*)(h_row+x), _mm_packs_epi32(sum0, sum1));
+    }
+#endif
+    for (; x < dst.cols; x++)
+      h_row[x] = pairs[2*x]*col_weights[2*x] + pairs[2*x+1]*col_weights[2*x+1];
+  }
+
+  // Vertical pass with the rows and weights of each output row
+  for (int y=0; y < dst.rows; y++)
+  {
+    const int Y = (cvRound((a*y + by)*AB_SCALE) + ROUND_DELTA) >> (AB_BITS - INTER_BITS);
+    const int sy = Y >> INTER_BITS, fy = Y & (INTER_SIZE-1);
+    const bool in0 = (sy >= 0) && (sy < src.rows), in1 = (sy+1 >= 0) && (sy+1 < src.rows);
+    uchar *dst_row = dst.ptr<uchar>(y);
+    if (!in0 && !in1)
+    {
+      memset(dst_row, 0, dst.cols);
+      continue;
+    }
+    const short *h0 = horizontal.ptr<short>(in0 ? sy : sy+1);
+    const short *h1 = horizontal.ptr<short>(in1 ? sy+1 : sy);
+    const int w0 = in0 ? INTER_SIZE - fy : 0, w1 = in1 ? fy : 0;
+    int x = 0;
+#if defined(__SSE2__)
+    const __m128i weights = _mm_set1_epi32((w1 << 16) | w0);
+    const __m128i delta = _mm_set1_epi32(1 << (2*INTER_BITS - 1));
+    for (; x <= dst.cols-8; x += 8)
+    {
+      __m128i v0 = _mm_loadu_si128((const __m128i*)(h0+x));
+      __m128i v1 = _mm_loadu_si128((const __m128i*)(h1+x));
+      __m128i sum0 = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(v0, v1), weights), delta), 2*INTER_BITS);
+      __m128i sum1 = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(v0, v1), weights), delta), 2*INTER_BITS);
+      _mm_storel_epi64((__m128i*)(dst_row+x), _mm_packus_epi16(_mm_packs_epi32(sum0, sum1), _mm_setzero_si128()));
+    }
+#endif
+    for (; x < dst.cols; x++)
+      dst_row[x] = static_cast<uchar>((h0[x]*w0 + h1[x]*w1 + (1 << (2*INTER_BITS - 1))) >> (2*INTER_BITS));
+  }
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method: the same affine transformation maps output pixels to the
+// oversampled field, which is bilinearly interpolated. Distances are scaled
+// with the image and the weight shifts the edge, then a one pixel ramp around
+// the edge gives the antialiased coverage.
+// Inputs: distance field oversampled by an integer factor of the image
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+void
+distanceFieldTransform
+  (
+  cv::RNG &rng,
+  const cv::Mat &sdf,
+  cv::Mat &img,
+  Augmentation &aug
+  )
+{
+  ProfileScope scope("sdf");
+  float scale = rng.uniform(0.9f, 0.95f); // scale about origin
+  float tx = rng.uniform(-1.0f, 2.0f); // translate
+  float ty = rng.uniform(-1.0f, 2.0f); // translate
+  float weight = rng.uniform(-1.0f, 1.0f); // thicken or thin the strokes
+  aug.scale = scale;
+  aug.tx = tx;
+  aug.ty = ty;
+  aug.weight = weight;
+
+  // Inverse map from the image pixels to the field pixels
+  float factor = static_cast<float>(sdf.cols) / img.cols;
+  float offset = 0.5f*(factor - 1.0f);
+  cv::Matx23f M( factor/scale, 0.0f, offset - tx*factor/scale,
+                 0.0f, factor/scale, offset - ty*factor/scale );
+
+  cv::Mat distance, output;
+  cv::warpAffine(sdf, distance, M, img.size(), cv::INTER_LINEAR | cv::WARP_INVERSE_MAP, cv::BORDER_CONSTANT, cv::Scalar(img.rows + img.cols));
+  distance.convertTo(output, CV_8U, -255.0*scale, 255.0*(0.5 + weight));
+  img = output;
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method: each output pixel covers a '1/scale' pixels footprint
+// of the image, centered where the affine transformation samples it. Its
+// bounds are rounded to master pixels, so the pixel is the integer mean of a
+// box of the master: rows of the box are summed first with 16 bits vectors,
+// then the columns of each box.
+// Inputs: bitmap supersampled by an integer factor of the image, aligned
+// with its pixels
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats: translations are rounded to 1/factor pixels.
+// Boxes hold at most 257 rows, so the factor must be below 230.
+//
+// -----------------------------------------------------------------------------
+void
+supersampledTransform
+  (
+  cv::RNG &rng,
+  const cv::Mat &master,
+  cv::Mat &img,
+  Augmentation &aug
+  )
+{
+  ProfileScope scope("supersampled");
+  float scale = rng.uniform(0.9f, 0.95f); // scale about origin
+  float tx = rng.uniform(-1.0f, 2.0f); // translate
+  float ty = rng.uniform(-1.0f, 2.0f); // translate
+  aug.scale = scale;
+  aug.tx = tx;
+  aug.ty = ty;
+
+  // Bounds of the footprint of each output pixel in the master, the box
+  // keeps its area outside the master as a zero border
+  const float factor = static_cast<float>(master.cols) / img.cols;
+  std::vector<int> xs(img.cols+1), ys(img.rows+1);
+  for (int u=0; u <= img.cols; u++)
+    xs[u] = cvRound(factor*((u - tx - 0.5f)/scale + 0.5f));
+  for (int v=0; v <= img.rows; v++)
+    ys[v] = cvRound(factor*((v - ty - 0.5f)/scale + 0.5f));
+
+  cv::Mat output(img.size(), CV_8UC1);
+  std::vector<uint16_t> sums(master.cols);
+  for (int v=0; v < img.rows; v++)
+  {
+    std::fill(sums.begin(), sums.end(), 0);
+    const int first_row = std::max(ys[v], 0), last_row = std::min(ys[v+1], master.rows);
+    for (int row=first_row; row < last_row; row++)
+    {
+      const uchar *master_row = master.ptr<uchar>(row);
+      int col = 0;
+#if defined(__SSE2__)
+      const __m128i zero = _mm_setzero_si128();
+      for (; col <= master.cols-16; col += 16)
+      {
+        __m128i pixels = _mm_loadu_si128((const __m128i*)(master_row+col));
+        __m128i *acc = (__m128i*)(&sums[col]);
+        _mm_storeu_si128(acc, _mm_add_epi16(_mm_loadu_si128(acc), _mm_unpacklo_epi8(pixels, zero)));
+        _mm_storeu_si128(acc+1, _mm_add_epi16(_mm_loadu_si128(acc+1), _mm_unpackhi_epi8(pixels, zero)));
+      }
+#endif
+      for (; col < master.cols; col++)
+        sums[col] += master_row[col];
+    }
+
+    uchar *dst_row = output.ptr<uchar>(v);
+    const int height = ys[v+1] - ys[v];
+    for (int u=0; u < img.cols; u++)
+    {
+      unsigned sum = 0;
+      const int last_col = std::min(xs[u+1], master.cols);
+      for (int col=std::max(xs[u], 0); col < last_col; col++)
+        sum += sums[col];
+      const unsigned area = std::max((xs[u+1] - xs[u]) * height, 1);
+      dst_row[u] = static_cast<uchar>((sum + area/2) / area);
+    }
+  }
+  img = output;
 }
 
 // -----------------------------------------------------------------------------
@@ -57,14 +312,17 @@ void
 smoothTransform
   (
   cv::RNG &rng,
-  cv::Mat &img
+  cv::Mat &img,
+  Augmentation &aug
   )
 {
+  ProfileScope scope("smooth");
   int option = rng.uniform(0, 2);
   if (option == 1)
   {
     cv::Mat output;
     int kernel_size = rng.uniform(2, 4);
+    aug.blur = kernel_size;
     cv::blur(img, output, cv::Size(kernel_size,kernel_size), cv::Point(-1,-1));
     img = output.clone();
   }
@@ -83,13 +341,16 @@ void
 morphologicTransform
   (
   cv::RNG &rng,
-  cv::Mat &img
+  cv::Mat &img,
+  Augmentation &aug
   )
 {
+  ProfileScope scope("morphology");
   cv::Mat output, kernel = cv::Mat(3, 3, CV_8U);
   cv::Point anchor = cv::Point(-1,-1);
   int iters = 1, border_type = cv::BORDER_REPLICATE;
   int option = rng.uniform(0, 3);
+  aug.morphology = option;
   switch (option)
   {
     case 0:
@@ -121,6 +382,7 @@ modifyPixelsIntensity
   cv::Mat &img
   )
 {
+  ProfileScope scope("intensity");
   // Modify pixel intensity in background and character
   for (int row=0; row < img.rows; row++)
   {
@@ -148,10 +410,13 @@ void
 anisotropicFilter
   (
   cv::RNG &rng,
-  cv::Mat &img
+  cv::Mat &img,
+  Augmentation &aug
   )
 {
+  ProfileScope scope("anisotropic");
   int option = rng.uniform(0, 2);
+  aug.anisotropic = option;
   if (option == 1)
   {
     // Preprocess the generated images
@@ -161,12 +426,8 @@ anisotropicFilter
     anisotropicSmooth(img, smoothed, conv_mask);
 
     cv::Mat output;
-    cv::add(smoothed, cv::Scalar(0.000001), smoothed); // CV_32FC1
-    img.convertTo(img, CV_32FC1);
-    cv::divide(img, smoothed, output);
-    output.convertTo(output, CV_8UC1); // CV_8UC1
-    cv::equalizeHist(output, output);
-    img = output.clone();
+    anisotropicEqualize(img, smoothed, output);
+    img = output;
   }
 }
 
@@ -233,6 +494,7 @@ anisotropicSmooth
   cv::Mat &kernel
   )
 {
+  ProfileScope scope("anisotropic_smooth");
   // Add convolution borders to apply anisotropic filter
   float offset_j = floor(kernel.cols / 2.0f);
   float offset_i = floor(kernel.rows / 2.0f);
@@ -276,4 +538,91 @@ anisotropicSmooth
   }
 };
 
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method: adds epsilon to the smoothed image, divides, converts to
+// 8 bits and equalizes the histogram like the OpenCV calls did, but the ratio
+// is rounded to 8 bits and counted in the histogram in the same pass. A second
+// pass applies the equalization look up table.
+// Inputs: 8 bits image and its floating point anisotropic smooth
+// Outputs: 8 bits equalized ratio image
+// Dependencies:
+// Restrictions and Caveats: follows the cv::equalizeHist look up table. The
+// division may round a ratio to the other gray level, see check_operations.
+//
+// -----------------------------------------------------------------------------
+void
+anisotropicEqualize
+  (
+  const cv::Mat &img,
+  const cv::Mat &smoothed,
+  cv::Mat &dst
+  )
+{
+  ProfileScope scope("anisotropic_equalize");
+  const float EPS = 0.000001f;
+  dst.create(img.rows, img.cols, CV_8UC1);
+
+  int hist[256] = { 0 };
+  for (int row=0; row < img.rows; row++)
+  {
+    const uchar *src_row = img.ptr<uchar>(row);
+    const float *smooth_row = smoothed.ptr<float>(row);
+    uchar *dst_row = dst.ptr<uchar>(row);
+    int col = 0;
+#if defined(__SSE2__)
+    const __m128 eps = _mm_set1_ps(EPS);
+    const __m128i zero = _mm_setzero_si128();
+    for (; col <= img.cols-8; col += 8)
+    {
+      __m128i pixels = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(src_row+col)), zero);
+      __m128 num0 = _mm_cvtepi32_ps(_mm_unpacklo_epi16(pixels, zero));
+      __m128 num1 = _mm_cvtepi32_ps(_mm_unpackhi_epi16(pixels, zero));
+      __m128 den0 = _mm_add_ps(_mm_loadu_ps(smooth_row+col), eps);
+      __m128 den1 = _mm_add_ps(_mm_loadu_ps(smooth_row+col+4), eps);
+      __m128i ratio0 = _mm_cvtps_epi32(_mm_div_ps(num0, den0));
+      __m128i ratio1 = _mm_cvtps_epi32(_mm_div_ps(num1, den1));
+      __m128i ratio = _mm_packus_epi16(_mm_packs_epi32(ratio0, ratio1), zero);
+      _mm_storel_epi64((__m128i*)(dst_row+col), ratio);
+      for (int k=0; k < 8; k++)
+        hist[dst_row[col+k]]++;
+    }
+#endif
+    for (; col < img.cols; col++)
+    {
+      float ratio = static_cast<float>(src_row[col]) / (smooth_row[col] + EPS);
+      dst_row[col] = cv::saturate_cast<uchar>(ratio);
+      hist[dst_row[col]]++;
+    }
+  }
+
+  // Equalization look up table
+  const int total = img.rows*img.cols;
+  if (total == 0)
+    return;
+  int idx = 0;
+  while (!hist[idx])
+    idx++;
+  if (hist[idx] == total)
+  {
+    dst.setTo(cv::Scalar(idx));
+    return;
+  }
+  uchar lut[256];
+  float scale = (256 - 1.0f)/(total - hist[idx]);
+  int sum = 0;
+  for (lut[idx++] = 0; idx < 256; idx++)
+  {
+    sum += hist[idx];
+    lut[idx] = cv::saturate_cast<uchar>(sum * scale);
+  }
+
+  for (int row=0; row < dst.rows; row++)
+  {
+    uchar *dst_row = dst.ptr<uchar>(row);
+    for (int col=0; col < dst.cols; col++)
+      dst_row[col] = lut[dst_row[col]];
+  }
+}
+
 }; // close namespace urjc
@@ -10,7 +10,11 @@
 
 // ----------------------- INCLUDES --------------------------------------------
 #include <utils.hpp>
+#include <trace.hpp>
 #include <string>
+#include <fcntl.h>
+#include <unistd.h>
+#include <boost/filesystem.hpp>
 
 namespace urjc {
 
@@ -211,4 +215,154 @@ string2AsciiCode
   return idx;
 }
 
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method: the leading byte gives the length of the sequence and
+// the first bits, each continuation byte six more bits.
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats: the sequence is not validated.
+//
+// -----------------------------------------------------------------------------
+unsigned
+utf8CodePoint
+  (
+  const std::string &character
+  )
+{
+  if (character.empty())
+    return 0;
+  const unsigned char lead = character[0];
+  unsigned length = (lead < 0x80) ? 1 : (lead < 0xE0) ? 2 : (lead < 0xF0) ? 3 : 4;
+  unsigned code = (length == 1) ? lead : lead & (0x7F >> length);
+  for (unsigned k=1; (k < length) && (k < character.size()); k++)
+    code = (code << 6) | (static_cast<unsigned char>(character[k]) & 0x3F);
+  return code;
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method: SplitMix64 finalizer, so that consecutive samples get
+// uncorrelated seeds.
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+uint64_t
+sampleSeed
+  (
+  const uint64_t seed,
+  const unsigned idx,
+  const unsigned sample
+  )
+{
+  uint64_t z = seed + 0x9E3779B97F4A7C15ULL*(((static_cast<uint64_t>(idx) << 32) | sample) + 1);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method:
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+void
+writeString
+  (
+  std::ostream &os,
+  const std::string &str
+  )
+{
+  uint32_t length = str.size();
+  writeValue(os, length);
+  os.write(str.data(), length);
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method:
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+void
+readString
+  (
+  std::istream &is,
+  std::string &str
+  )
+{
+  uint32_t length = 0;
+  readValue(is, length);
+  str.resize(length);
+  if (length > 0)
+    is.read(&str[0], length);
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method: files and directories are opened read only, fsync
+// flushes the whole inode whatever the mode.
+// Inputs:
+// Outputs:
+// Dependencies: POSIX fsync
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+bool
+syncPath
+  (
+  const std::string &path
+  )
+{
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+  {
+    ERROR("Error. " << path << " can't be opened");
+    return false;
+  }
+  bool synced = (fsync(fd) == 0);
+  close(fd);
+  if (!synced)
+    ERROR("Error. " << path << " can't be flushed to disk");
+  return synced;
+}
+
+// -----------------------------------------------------------------------------
+//
+// Purpose and Method: directories are flushed after their entries, so the
+// names of new files are durable too.
+// Inputs:
+// Outputs:
+// Dependencies:
+// Restrictions and Caveats:
+//
+// -----------------------------------------------------------------------------
+bool
+syncDirectory
+  (
+  const std::string &path
+  )
+{
+  bool synced = true;
+  boost::filesystem::recursive_directory_iterator it(path), end;
+  for (; it != end; it++)
+    if (boost::filesystem::is_regular_file(it->status()))
+      synced = syncPath(it->path().string()) && synced;
+  for (it = boost::filesystem::recursive_directory_iterator(path); it != end; it++)
+    if (boost::filesystem::is_directory(it->status()))
+      synced = syncPath(it->path().string()) && synced;
+  return syncPath(path) && synced;
+}
+
 }; // close namespace urjc